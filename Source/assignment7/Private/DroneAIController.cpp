@@ -0,0 +1,186 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DroneAIController.h"
+#include "DronePawn.h"
+
+ADroneAIController::ADroneAIController() :
+	MaxSpeed(600.0f),
+	AcceptanceRadius(150.0f),
+	VelocityGain(1.5f),
+	MaxTiltAngle(25.0f),
+	TiltRate(60.0f),
+	RetryDelay(1.0f),
+	PathIndex(0),
+	Destination(FVector::ZeroVector),
+	bHasDestination(false),
+	PendingRequestId(0),
+	RetryTimer(0.0f)
+{
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+void ADroneAIController::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UDroneNavSubsystem* Nav = GetWorld()->GetSubsystem<UDroneNavSubsystem>())
+	{
+		GridChangedHandle = Nav->OnGridChanged.AddUObject(this, &ADroneAIController::OnGridChanged);
+	}
+}
+
+void ADroneAIController::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelPendingRequest();
+	if (UDroneNavSubsystem* Nav = GetWorld()->GetSubsystem<UDroneNavSubsystem>())
+	{
+		Nav->OnGridChanged.Remove(GridChangedHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ADroneAIController::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	ADronePawn* Drone = Cast<ADronePawn>(GetPawn());
+	if (!Drone || !bHasDestination) return;
+
+	if (Path.Points.Num() == 0)
+	{
+		if (PendingRequestId == 0)
+		{
+			RetryTimer -= DeltaTime;
+			if (RetryTimer <= 0.0f) RequestPath();
+		}
+		return;
+	}
+
+	FollowPath(Drone, DeltaTime);
+}
+
+void ADroneAIController::FlyTo(const FVector& InDestination)
+{
+	CancelPendingRequest();
+	Path = FDronePath();
+	PathIndex = 0;
+	Destination = InDestination;
+	bHasDestination = true;
+	RequestPath();
+}
+
+void ADroneAIController::StopFlying()
+{
+	CancelPendingRequest();
+	Path = FDronePath();
+	PathIndex = 0;
+	bHasDestination = false;
+}
+
+void ADroneAIController::RequestPath()
+{
+	UDroneNavSubsystem* Nav = GetWorld()->GetSubsystem<UDroneNavSubsystem>();
+	if (!Nav || !GetPawn())
+	{
+		RetryTimer = RetryDelay;
+		return;
+	}
+
+	PendingRequestId = Nav->RequestPath(
+		GetPawn()->GetActorLocation(),
+		Destination,
+		FOnDronePathReady::CreateUObject(this, &ADroneAIController::OnPathReady, false)
+	);
+}
+
+void ADroneAIController::CancelPendingRequest()
+{
+	if (PendingRequestId == 0) return;
+
+	if (UDroneNavSubsystem* Nav = GetWorld()->GetSubsystem<UDroneNavSubsystem>())
+	{
+		Nav->CancelRequest(PendingRequestId);
+	}
+	PendingRequestId = 0;
+}
+
+void ADroneAIController::OnPathReady(const FDronePath& InPath, bool bIsRepair)
+{
+	PendingRequestId = 0;
+
+	if (!InPath.bSuccess || InPath.Points.Num() == 0)
+	{
+		Path = FDronePath();
+		PathIndex = 0;
+		RetryTimer = RetryDelay;
+		return;
+	}
+
+	// A repair keeps everything before PathIndex, so progress along the path carries over
+	Path = InPath;
+	if (!bIsRepair) PathIndex = 0;
+	PathIndex = FMath::Min(PathIndex, Path.Points.Num() - 1);
+}
+
+void ADroneAIController::OnGridChanged(const TSet<FIntVector>& ChangedVoxels)
+{
+	if (Path.Points.Num() == 0 || PendingRequestId != 0) return;
+
+	UDroneNavSubsystem* Nav = GetWorld()->GetSubsystem<UDroneNavSubsystem>();
+	if (Nav && Nav->IsPathBlocked(Path, PathIndex))
+	{
+		PendingRequestId = Nav->RequestRepair(
+			Path,
+			PathIndex,
+			FOnDronePathReady::CreateUObject(this, &ADroneAIController::OnPathReady, true)
+		);
+	}
+}
+
+void ADroneAIController::FollowPath(ADronePawn* Drone, float DeltaTime)
+{
+	const FVector Location = Drone->GetActorLocation();
+	const float AcceptanceRadiusSq = FMath::Square(AcceptanceRadius);
+
+	while (PathIndex < Path.Points.Num() - 1 && FVector::DistSquared(Location, Path.Points[PathIndex]) < AcceptanceRadiusSq)
+	{
+		++PathIndex;
+	}
+
+	// Only brake into the last point, the ones before it are flown through
+	const bool bFinalPoint = PathIndex == Path.Points.Num() - 1;
+	const FVector ToTarget = Path.Points[PathIndex] - Location;
+	const float Speed = bFinalPoint ? FMath::Min(MaxSpeed, (float)ToTarget.Size() * VelocityGain) : MaxSpeed;
+	const FVector DesiredVelocity = ToTarget.GetSafeNormal() * Speed;
+	const FVector DesiredAcceleration = (DesiredVelocity - Drone->GetVelocity()) * VelocityGain;
+
+	if (bFinalPoint && ToTarget.SizeSquared() < AcceptanceRadiusSq)
+	{
+		StopFlying();
+		return;
+	}
+
+	if (DesiredVelocity.SizeSquared2D() > 1.0f)
+	{
+		Drone->SetLookYaw(DesiredVelocity.Rotation().Yaw);
+	}
+
+	// Lift acts along the drone's up vector, so tilting trades vertical for horizontal acceleration.
+	// Nose down (negative pitch) accelerates forward, right side down (positive roll) accelerates right.
+	const FRotator3f Rotation(Drone->GetActorRotation());
+	const FVector3f LocalAcceleration(FRotator(0.0f, Rotation.Yaw, 0.0f).UnrotateVector(DesiredAcceleration));
+	const float Gravity = Drone->GetGravity();
+
+	const float TargetPitch = FMath::Clamp(FMath::RadiansToDegrees(FMath::Atan2(-LocalAcceleration.X, Gravity)), -MaxTiltAngle, MaxTiltAngle);
+	const float TargetRoll = FMath::Clamp(FMath::RadiansToDegrees(FMath::Atan2(LocalAcceleration.Y, Gravity)), -MaxTiltAngle, MaxTiltAngle);
+	const float MaxTiltStep = TiltRate * DeltaTime;
+	const float LiftLoss = Gravity * (1.0f - FMath::Cos(FMath::DegreesToRadians(Rotation.Pitch)) * FMath::Cos(FMath::DegreesToRadians(Rotation.Roll)));
+
+	FVector FlightInput;
+	FlightInput.X = FMath::Clamp(TargetPitch - Rotation.Pitch, -MaxTiltStep, MaxTiltStep);
+	FlightInput.Y = FMath::Clamp(TargetRoll - Rotation.Roll, -MaxTiltStep, MaxTiltStep);
+	FlightInput.Z = FMath::Clamp(((float)DesiredAcceleration.Z + LiftLoss) / Drone->GetMoveScalar(), -1.0f, 1.0f);
+	Drone->AddFlightInput(FlightInput);
+}
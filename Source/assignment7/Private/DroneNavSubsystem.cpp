@@ -0,0 +1,383 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DroneNavSubsystem.h"
+#include "EngineUtils.h"
+#include "Tasks/Task.h"
+
+namespace DroneNav
+{
+	// Replaces every blocked stretch after FromIndex with a fresh search between its free neighbours
+	static bool RepairPath(const FVoxelOccupancyGrid& Grid, TArray<FIntVector>& Voxels, int32 FromIndex)
+	{
+		for (int32 Index = FromIndex; Index < Voxels.Num(); ++Index)
+		{
+			if (!Grid.IsBlocked(Voxels[Index])) continue;
+
+			int32 End = Index;
+			while (End + 1 < Voxels.Num() && Grid.IsBlocked(Voxels[End + 1])) ++End;
+
+			const int32 ReplaceFirst = Index > FromIndex ? Index - 1 : Index;
+			const int32 ReplaceLast = End + 1 < Voxels.Num() ? End + 1 : End;
+
+			FIntVector From = Voxels[ReplaceFirst];
+			FIntVector To = Voxels[ReplaceLast];
+			if (!Grid.FindNearestFree(From, UDroneNavSubsystem::MaxSnapRadius, From) ||
+				!Grid.FindNearestFree(To, UDroneNavSubsystem::MaxSnapRadius, To))
+			{
+				return false;
+			}
+
+			TArray<FIntVector> Segment;
+			if (!Grid.FindPath(From, To, UDroneNavSubsystem::MaxExpansions, Segment)) return false;
+
+			Voxels.RemoveAt(ReplaceFirst, ReplaceLast - ReplaceFirst + 1);
+			Voxels.Insert(Segment, ReplaceFirst);
+			Index = ReplaceFirst + Segment.Num() - 1;
+		}
+		return true;
+	}
+}
+
+UDroneNavSubsystem::UDroneNavSubsystem() :
+	Completed(MakeShared<FCompletedQueue>()),
+	NextRequestId(1),
+	GridVersion(0)
+{
+}
+
+bool UDroneNavSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UDroneNavSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UDroneNavSubsystem, STATGROUP_Tickables);
+}
+
+// Bakes everything static with collision, plus headroom above it to fly in
+void UDroneNavSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	FBox Bounds(ForceInit);
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		const USceneComponent* Root = It->GetRootComponent();
+		if (!Root || Root->Mobility != EComponentMobility::Static || !It->GetActorEnableCollision()) continue;
+
+		Bounds += It->GetComponentsBoundingBox();
+	}
+	if (!Bounds.IsValid) return;
+
+	Bounds.Max.Z += BakeHeadroom;
+
+	const FVector Extent = Bounds.GetExtent().ComponentMin(FVector(MaxBakeExtent * 0.5));
+	BakeFromStaticCollision(FBox(Bounds.GetCenter() - Extent, Bounds.GetCenter() + Extent));
+}
+
+void UDroneNavSubsystem::Deinitialize()
+{
+	// Tasks still in flight only hold the snapshot and the shared queue, nothing here
+	Pending.Empty();
+	Cache.Empty();
+	Grid.Reset();
+
+	Super::Deinitialize();
+}
+
+void UDroneNavSubsystem::BakeFromStaticCollision(const FBox& Bounds)
+{
+	const double StartTime = FPlatformTime::Seconds();
+
+	const FVector Size = Bounds.GetSize() / VoxelSize;
+	const FIntVector MaxVoxel(
+		FMath::Max(FMath::CeilToInt32(Size.X) - 1, 0),
+		FMath::Max(FMath::CeilToInt32(Size.Y) - 1, 0),
+		FMath::Max(FMath::CeilToInt32(Size.Z) - 1, 0)
+	);
+	TSharedRef<FVoxelOccupancyGrid> NewGrid = MakeShared<FVoxelOccupancyGrid>(Bounds.Min, VoxelSize, FIntVector(0), MaxVoxel);
+
+	const int32 RootSize = FMath::RoundUpToPowerOfTwo(MaxVoxel.GetMax() + 1);
+	BakeNode(*NewGrid, FIntVector(0), RootSize);
+
+	Grid = NewGrid;
+	++GridVersion;
+	Cache.Empty();
+
+	UE_LOG(LogTemp, Log, TEXT("DroneNav: baked %d x %d x %d voxels into %d bricks in %.1f ms"),
+		MaxVoxel.X + 1, MaxVoxel.Y + 1, MaxVoxel.Z + 1, NewGrid->GetNumBricks(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+// Octree style descent, empty space is rejected with a single overlap test per node
+void UDroneNavSubsystem::BakeNode(FVoxelOccupancyGrid& Target, const FIntVector& MinVoxel, int32 Size) const
+{
+	if (!Target.IsInBounds(MinVoxel)) return;
+
+	const FVector Center = Target.VoxelToWorld(MinVoxel) + FVector((Size - 1) * VoxelSize * 0.5f);
+	const FVector HalfExtent = FVector(Size * VoxelSize * 0.5f + AgentRadius);
+
+	if (!GetWorld()->OverlapAnyTestByObjectType(
+		Center,
+		FQuat::Identity,
+		FCollisionObjectQueryParams(ECC_WorldStatic),
+		FCollisionShape::MakeBox(HalfExtent)))
+	{
+		return;
+	}
+
+	if (Size == 1)
+	{
+		Target.SetOccupied(MinVoxel, true);
+		return;
+	}
+
+	const int32 Half = Size / 2;
+	for (int32 Child = 0; Child < 8; ++Child)
+	{
+		const FIntVector Offset((Child & 1) ? Half : 0, (Child & 2) ? Half : 0, (Child & 4) ? Half : 0);
+		BakeNode(Target, MinVoxel + Offset, Half);
+	}
+}
+
+void UDroneNavSubsystem::RefreshRegion(const FBox& Region)
+{
+	if (!Grid) return;
+
+	const FIntVector& GridMin = Grid->GetMinVoxel();
+	const FIntVector& GridMax = Grid->GetMaxVoxel();
+	const FIntVector RegionMin = Grid->WorldToVoxel(Region.Min - FVector(AgentRadius));
+	const FIntVector RegionMax = Grid->WorldToVoxel(Region.Max + FVector(AgentRadius));
+	const FIntVector Min(FMath::Max(RegionMin.X, GridMin.X), FMath::Max(RegionMin.Y, GridMin.Y), FMath::Max(RegionMin.Z, GridMin.Z));
+	const FIntVector Max(FMath::Min(RegionMax.X, GridMax.X), FMath::Min(RegionMax.Y, GridMax.Y), FMath::Min(RegionMax.Z, GridMax.Z));
+
+	TSharedRef<FVoxelOccupancyGrid> NewGrid = MakeShared<FVoxelOccupancyGrid>(*Grid);
+	for (int32 X = Min.X; X <= Max.X; ++X)
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+			for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+				NewGrid->SetOccupied(FIntVector(X, Y, Z), false);
+
+	constexpr int32 NodeSize = 4;
+	for (int32 X = Min.X; X <= Max.X; X += NodeSize)
+		for (int32 Y = Min.Y; Y <= Max.Y; Y += NodeSize)
+			for (int32 Z = Min.Z; Z <= Max.Z; Z += NodeSize)
+				BakeNode(*NewGrid, FIntVector(X, Y, Z), NodeSize);
+
+	TSet<FIntVector> Changed;
+	for (int32 X = Min.X; X <= Max.X; ++X)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 Z = Min.Z; Z <= Max.Z; ++Z)
+			{
+				const FIntVector Voxel(X, Y, Z);
+				if (Grid->IsOccupied(Voxel) != NewGrid->IsOccupied(Voxel))
+				{
+					Changed.Add(Voxel);
+				}
+			}
+		}
+	}
+
+	if (Changed.Num() > 0)
+	{
+		ApplyGridChange(NewGrid, Changed);
+	}
+}
+
+void UDroneNavSubsystem::SetVoxelsOccupied(TArrayView<const FIntVector> Voxels, bool bOccupied)
+{
+	if (!Grid) return;
+
+	TSharedRef<FVoxelOccupancyGrid> NewGrid = MakeShared<FVoxelOccupancyGrid>(*Grid);
+	TSet<FIntVector> Changed;
+	for (const FIntVector& Voxel : Voxels)
+	{
+		if (Grid->IsOccupied(Voxel) != bOccupied)
+		{
+			NewGrid->SetOccupied(Voxel, bOccupied);
+			Changed.Add(Voxel);
+		}
+	}
+
+	if (Changed.Num() > 0)
+	{
+		ApplyGridChange(NewGrid, Changed);
+	}
+}
+
+// Planner tasks keep the snapshot they started with, the swap never blocks them
+void UDroneNavSubsystem::ApplyGridChange(TSharedRef<FVoxelOccupancyGrid> NewGrid, const TSet<FIntVector>& Changed)
+{
+	Grid = NewGrid;
+	++GridVersion;
+
+	for (auto It = Cache.CreateIterator(); It; ++It)
+	{
+		for (const FIntVector& Voxel : It.Value().Voxels)
+		{
+			if (Changed.Contains(Voxel))
+			{
+				It.RemoveCurrent();
+				break;
+			}
+		}
+	}
+
+	OnGridChanged.Broadcast(Changed);
+}
+
+bool UDroneNavSubsystem::IsPathBlocked(const FDronePath& Path, int32 FromIndex) const
+{
+	if (!Grid) return false;
+
+	for (int32 Index = FMath::Max(FromIndex, 0); Index < Path.Voxels.Num(); ++Index)
+	{
+		if (Grid->IsBlocked(Path.Voxels[Index])) return true;
+	}
+	return false;
+}
+
+uint32 UDroneNavSubsystem::RequestPath(const FVector& Start, const FVector& Goal, FOnDronePathReady OnReady)
+{
+	const uint32 RequestId = NextRequestId++;
+	Pending.Add(RequestId, MoveTemp(OnReady));
+
+	FIntVector StartVoxel;
+	FIntVector GoalVoxel;
+	if (!Grid ||
+		!Grid->FindNearestFree(Grid->WorldToVoxel(Start), MaxSnapRadius, StartVoxel) ||
+		!Grid->FindNearestFree(Grid->WorldToVoxel(Goal), MaxSnapRadius, GoalVoxel))
+	{
+		// Failures are delivered like results so callers only have one code path
+		Completed->Enqueue(FCompletedRequest{ RequestId, FIntVector::ZeroValue, FIntVector::ZeroValue, INDEX_NONE, FDronePath() });
+		return RequestId;
+	}
+
+	if (FCachedPath* Cached = Cache.Find(FPathKey(StartVoxel, GoalVoxel)))
+	{
+		Cached->LastUsedFrame = GFrameCounter;
+
+		FDronePath Path;
+		Path.Voxels = Cached->Voxels;
+		Path.GridVersion = GridVersion;
+		Path.bSuccess = true;
+		Completed->Enqueue(FCompletedRequest{ RequestId, StartVoxel, GoalVoxel, INDEX_NONE, MoveTemp(Path) });
+		return RequestId;
+	}
+
+	LaunchSearch(RequestId, StartVoxel, GoalVoxel);
+	return RequestId;
+}
+
+uint32 UDroneNavSubsystem::RequestRepair(const FDronePath& Path, int32 FromIndex, FOnDronePathReady OnReady)
+{
+	const uint32 RequestId = NextRequestId++;
+	Pending.Add(RequestId, MoveTemp(OnReady));
+
+	if (!Grid || Path.Voxels.Num() == 0)
+	{
+		Completed->Enqueue(FCompletedRequest{ RequestId, FIntVector::ZeroValue, FIntVector::ZeroValue, FromIndex, FDronePath() });
+		return RequestId;
+	}
+
+	LaunchRepair(RequestId, Path.Voxels, FMath::Clamp(FromIndex, 0, Path.Voxels.Num() - 1));
+	return RequestId;
+}
+
+void UDroneNavSubsystem::CancelRequest(uint32 RequestId)
+{
+	Pending.Remove(RequestId);
+}
+
+void UDroneNavSubsystem::LaunchSearch(uint32 RequestId, const FIntVector& StartVoxel, const FIntVector& GoalVoxel)
+{
+	UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[Snapshot = Grid, Results = Completed, Version = GridVersion, RequestId, StartVoxel, GoalVoxel]()
+		{
+			FCompletedRequest Result{ RequestId, StartVoxel, GoalVoxel, INDEX_NONE, FDronePath() };
+			Result.Path.GridVersion = Version;
+			Result.Path.bSuccess = Snapshot->FindPath(StartVoxel, GoalVoxel, MaxExpansions, Result.Path.Voxels);
+			Results->Enqueue(MoveTemp(Result));
+		});
+}
+
+void UDroneNavSubsystem::LaunchRepair(uint32 RequestId, const TArray<FIntVector>& Voxels, int32 FromIndex)
+{
+	UE::Tasks::Launch(UE_SOURCE_LOCATION,
+		[Snapshot = Grid, Results = Completed, Version = GridVersion, RequestId, Voxels, FromIndex]()
+		{
+			FCompletedRequest Result{ RequestId, Voxels[0], Voxels.Last(), FromIndex, FDronePath() };
+			Result.Path.GridVersion = Version;
+			Result.Path.Voxels = Voxels;
+			Result.Path.bSuccess = DroneNav::RepairPath(*Snapshot, Result.Path.Voxels, FromIndex);
+			Results->Enqueue(MoveTemp(Result));
+		});
+}
+
+void UDroneNavSubsystem::AddToCache(const FPathKey& Key, const TArray<FIntVector>& Voxels)
+{
+	if (Cache.Num() >= MaxCachedPaths && !Cache.Contains(Key))
+	{
+		// Evict the least recently used path
+		const FPathKey* Oldest = nullptr;
+		uint64 OldestFrame = MAX_uint64;
+		for (const TPair<FPathKey, FCachedPath>& Pair : Cache)
+		{
+			if (Pair.Value.LastUsedFrame < OldestFrame)
+			{
+				OldestFrame = Pair.Value.LastUsedFrame;
+				Oldest = &Pair.Key;
+			}
+		}
+		Cache.Remove(*Oldest);
+	}
+
+	FCachedPath& Cached = Cache.FindOrAdd(Key);
+	Cached.Voxels = Voxels;
+	Cached.LastUsedFrame = GFrameCounter;
+}
+
+void UDroneNavSubsystem::BuildPoints(FDronePath& Path) const
+{
+	Path.Points.Reset(Path.Voxels.Num());
+	for (const FIntVector& Voxel : Path.Voxels)
+	{
+		Path.Points.Add(Grid->VoxelToWorld(Voxel));
+	}
+}
+
+void UDroneNavSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	FCompletedRequest Result;
+	while (Completed->Dequeue(Result))
+	{
+		if (!Pending.Contains(Result.RequestId)) continue; // cancelled
+
+		const bool bIsRepair = Result.RepairFromIndex != INDEX_NONE;
+		if (Result.Path.bSuccess && Result.Path.GridVersion != GridVersion &&
+			IsPathBlocked(Result.Path, bIsRepair ? Result.RepairFromIndex : 0))
+		{
+			// The grid changed while this was being planned and the result runs into the change
+			if (bIsRepair) LaunchRepair(Result.RequestId, Result.Path.Voxels, Result.RepairFromIndex);
+			else LaunchSearch(Result.RequestId, Result.StartVoxel, Result.GoalVoxel);
+			continue;
+		}
+
+		if (Result.Path.bSuccess && !bIsRepair)
+		{
+			AddToCache(FPathKey(Result.StartVoxel, Result.GoalVoxel), Result.Path.Voxels);
+		}
+		if (Grid)
+		{
+			BuildPoints(Result.Path);
+		}
+
+		FOnDronePathReady OnReady;
+		Pending.RemoveAndCopyValue(Result.RequestId, OnReady);
+		OnReady.ExecuteIfBound(Result.Path);
+	}
+}
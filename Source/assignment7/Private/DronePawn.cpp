@@ -7,6 +7,9 @@
 #include "Camera/CameraComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "PawnMovementStep.h"
+#include "PawnHistorySubsystem.h"
+#include "TelemetrySubsystem.h"
 #include "Kismet/GameplayStatics.h"
 
 // Sets default values
@@ -39,6 +42,7 @@ ADronePawn::ADronePawn()
 	Gravity = 980.0f;
 	Force = FVector(0.0f, 0.0f, 0.0f);
 	Velocity = FVector(0.0f, 0.0f, 0.0f);
+	LastMoveInput = FVector(0.0f, 0.0f, 0.0f);
 	LookRotation = GetActorRotation();
 }
 
@@ -49,17 +53,38 @@ void ADronePawn::BeginPlay()
 	
 }
 
+void ADronePawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPawnHistorySubsystem* History = GetWorld()->GetSubsystem<UPawnHistorySubsystem>())
+	{
+		History->RemovePawn(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void ADronePawn::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	AddGravity();
-	AddLift();
-	Balance(DeltaTime);
-	Integration(DeltaTime);
-	HandleCollision(DeltaTime);
-	UpdatePosition(DeltaTime);
+	FPawnMovementState State;
+	State.Force = Force;
+	State.Velocity = Velocity;
+	State.Rotation = GetActorRotation();
+	State.LookRotation = LookRotation;
+
+	const FVector AppliedForce = FDroneMovementStep::Simulate(this, CapsuleComp, CollisionQuery, State, GetMovementParams(), DeltaTime,
+		[this](const FPawnMovementState& StepState, float StepDeltaTime)
+		{
+			SetActorRotation(StepState.Rotation);
+			Velocity = StepState.Velocity;
+			UpdatePosition(StepDeltaTime);
+		});
+
+	Force = State.Force;
+	RecordHistory(AppliedForce);
+	RecordTelemetry();
 }
 
 // Called to bind functionality to input
@@ -98,18 +123,23 @@ void ADronePawn::Move(const FInputActionValue& value)
 {
 	if (!Controller) return;
 
-	const FVector MoveInput = value.Get<FVector>();
+	AddFlightInput(value.Get<FVector>());
+}
+
+void ADronePawn::AddFlightInput(const FVector& FlightInput)
+{
+	LastMoveInput = FlightInput;
 
-	if (!FMath::IsNearlyZero(MoveInput.X) || !FMath::IsNearlyZero(MoveInput.Y))
+	if (!FMath::IsNearlyZero(FlightInput.X) || !FMath::IsNearlyZero(FlightInput.Y))
 	{
 		FRotator ActorRotation = GetActorRotation();
-		ActorRotation.Pitch += MoveInput.X;
-		ActorRotation.Roll += MoveInput.Y;
+		ActorRotation.Pitch += FlightInput.X;
+		ActorRotation.Roll += FlightInput.Y;
 		SetActorRotation(ActorRotation);
 	}
-	if (!FMath::IsNearlyZero(MoveInput.Z))
+	if (!FMath::IsNearlyZero(FlightInput.Z))
 	{
-		AddForce(GetActorUpVector() * Mass * MoveScalar * MoveInput.Z);
+		AddForce(GetActorUpVector() * Mass * MoveScalar * FlightInput.Z);
 	}
 }
 
@@ -126,89 +156,52 @@ void ADronePawn::Look(const FInputActionValue& value)
 	LookRotation.Yaw = ControlRotation.Yaw;
 }
 
-void ADronePawn::AddForce(FVector ExternalForce)
+void ADronePawn::SetLookYaw(float Yaw)
 {
-	Force += ExternalForce;
+	LookRotation.Yaw = Yaw;
 }
 
-void ADronePawn::AddGravity()
+void ADronePawn::AddForce(FVector ExternalForce)
 {
-	FVector GravityForce = FVector(0.0f, 0.0f, -Mass * Gravity); // * ߷
-	AddForce(GravityForce);
+	Force += ExternalForce;
 }
 
-void ADronePawn::AddLift()
+FPawnMovementParams ADronePawn::GetMovementParams() const
 {
-	FVector LiftForce = GetActorUpVector() * Mass * Gravity;
-	AddForce(LiftForce);
+	FPawnMovementParams Params;
+	Params.Mass = Mass;
+	Params.Gravity = Gravity;
+	Params.AirDrag = Drag;
+	Params.BalanceDrag = BalanceDrag;
+	Params.LookInterpSpeed = 5.0f;
+	return Params;
 }
 
-void ADronePawn::Balance(float DeltaTime)
+void ADronePawn::UpdatePosition(float DeltaTime)
 {
-	FRotator ActorRotation = GetActorRotation();
-
-	ActorRotation.Roll *= FMath::Pow(1 - BalanceDrag, DeltaTime);
-	ActorRotation.Pitch *= FMath::Pow(1 - BalanceDrag, DeltaTime);
-	ActorRotation.Yaw = FMath::RInterpTo(GetActorRotation(), LookRotation, DeltaTime, 5.0f).Yaw;
-
-	SetActorRotation(ActorRotation);
+	if (Velocity.IsNearlyZero()) return;
+	AddActorWorldOffset(Velocity * DeltaTime); // ġ ̵
 }
 
-void ADronePawn::Integration(float DeltaTime)
+void ADronePawn::RecordHistory(const FVector& AppliedForce)
 {
-	FVector Acceleration = Force * (1 / Mass); //F = ma
-	Velocity += Acceleration * DeltaTime;
-
-	Velocity *= FMath::Pow(1 - Drag, DeltaTime);
-
-	if (Velocity.SizeSquared() < 0.1f)
+	if (UPawnHistorySubsystem* History = GetWorld()->GetSubsystem<UPawnHistorySubsystem>())
 	{
-		Velocity = FVector::ZeroVector;
+		FPawnHistoryState State;
+		State.Location = GetActorLocation();
+		State.Rotation = GetActorRotation();
+		State.Velocity = Velocity;
+		State.Force = AppliedForce;
+		State.bIsGrounded = false;
+		History->RecordState(this, State);
 	}
-	Force = FVector::ZeroVector; //  ʱȭ
-}
-
-void ADronePawn::UpdatePosition(float DeltaTime)
-{
-	if (Velocity.IsNearlyZero()) return;
-	AddActorWorldOffset(Velocity * DeltaTime); // ġ ̵
 }
 
-void ADronePawn::HandleCollision(float DeltaTime)
+void ADronePawn::RecordTelemetry()
 {
-	TArray<FHitResult> HitResults;
-	FCollisionQueryParams CollisionParams;	//Ž    ü
-	CollisionParams.AddIgnoredActor(this);	//÷̾  
-
-	float Radius = CapsuleComp->GetScaledCapsuleRadius();
-	float HalfHeight = CapsuleComp->GetScaledCapsuleHalfHeight();
-
-
-	FVector NextPosition = GetActorLocation() + Velocity * DeltaTime;// ̵ ġ
-
-
-	bool bHit = GetWorld()->SweepMultiByChannel(
-		HitResults,											//ù°  浹  ü
-		NextPosition,										// ġ
-		NextPosition,										// ġ
-		GetActorQuat(),										//ȸ
-		ECollisionChannel::ECC_Visibility,					//  浹 
-		FCollisionShape::MakeCapsule(Radius, HalfHeight),	//浹
-		CollisionParams										//  ߰ Ű
-	);
-
-	for (const FHitResult& HitResult : HitResults) {
-		FVector ImpactNormal = HitResult.ImpactNormal;					//浹 ǥ   (ǥ ٱ Ű )
-		float DotProduct = FVector::DotProduct(Velocity, ImpactNormal);	// (  ̰)
-
-		if (DotProduct < 0)
-		{
-			Velocity -= DotProduct * ImpactNormal;
-		}
-
-		if (FMath::IsNearlyEqual(FVector::DotProduct(FVector(0, 0, 1), HitResult.ImpactNormal)/*ٴ Ȯ*/, 1.0f/*ġѴٸ*/, 0.1f/**/))
-		{
-			if (Velocity.Z < 0) Velocity.Z = 0;
-		}
+	if (UTelemetrySubsystem* Telemetry = GetWorld()->GetSubsystem<UTelemetrySubsystem>())
+	{
+		Telemetry->Record(this, Velocity, LastMoveInput, false);
 	}
+	LastMoveInput = FVector::ZeroVector; // input actions only fire on the frames they are held
 }
\ No newline at end of file
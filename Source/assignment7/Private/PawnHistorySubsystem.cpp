@@ -0,0 +1,221 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PawnHistorySubsystem.h"
+#include "GameFramework/Pawn.h"
+
+FPawnStateHistory::FPawnStateHistory(uint32 InCapacity, uint32 InKeyframeInterval) :
+	FrameMask(InCapacity - 1),
+	KeyframeMask(0),
+	KeyframeShift(FMath::FloorLog2(InKeyframeInterval)),
+	NewestStep(0),
+	NumFrames(0),
+	NumKeyframes(0),
+	LastKeyframeBlock(0)
+{
+	check(FMath::IsPowerOfTwo(InCapacity) && FMath::IsPowerOfTwo(InKeyframeInterval));
+	check(InCapacity >= InKeyframeInterval);
+
+	// Twice the slots the regular keyframes need, the rest absorbs teleports before the window starts shrinking
+	const uint32 NumSlots = InCapacity / InKeyframeInterval * 2;
+	check(NumSlots <= MAX_uint8 + 1);
+
+	KeyframeMask = NumSlots - 1;
+	Frames.SetNumZeroed(InCapacity);
+	Keyframes.SetNumZeroed(NumSlots);
+	KeyframeSteps.SetNumZeroed(NumSlots);
+}
+
+void FPawnStateHistory::Record(uint32 Step, const FPawnHistoryState& State)
+{
+	if (NumFrames > 0)
+	{
+		if (Step < NewestStep) return;
+
+		const uint32 Gap = Step - NewestStep;
+		if (Gap > FrameMask)
+		{
+			NumFrames = 0; // the whole window went stale, start over
+		}
+		else
+		{
+			for (uint32 Held = NewestStep + 1; Held < Step; ++Held)
+			{
+				WriteFrame(Held, LastState);
+			}
+		}
+	}
+
+	WriteFrame(Step, State);
+	LastState = State;
+}
+
+void FPawnStateHistory::WriteFrame(uint32 Step, const FPawnHistoryState& State)
+{
+	const uint32 Block = Step >> KeyframeShift;
+
+	FIntVector Delta;
+	bool bInRange = NumFrames > 0 && Block == LastKeyframeBlock;
+	if (bInRange)
+	{
+		const FVector Scaled = (State.Location - Keyframes[(NumKeyframes - 1) & KeyframeMask]) / LocationResolution;
+		Delta = FIntVector(FMath::RoundToInt32(Scaled.X), FMath::RoundToInt32(Scaled.Y), FMath::RoundToInt32(Scaled.Z));
+		bInRange = FMath::Max3(Delta.X, Delta.Y, Delta.Z) <= MAX_int16 && FMath::Min3(Delta.X, Delta.Y, Delta.Z) >= MIN_int16;
+	}
+
+	if (!bInRange)
+	{
+		// The first step of a block, or one the pawn teleported to, starts a keyframe the following steps share
+		Keyframes[NumKeyframes & KeyframeMask] = State.Location;
+		KeyframeSteps[NumKeyframes & KeyframeMask] = Step;
+		++NumKeyframes;
+		LastKeyframeBlock = Block;
+		Delta = FIntVector::ZeroValue;
+	}
+
+	FPawnHistoryFrame& Frame = Frames[Step & FrameMask];
+	Frame.LocationDelta[0] = (int16)Delta.X;
+	Frame.LocationDelta[1] = (int16)Delta.Y;
+	Frame.LocationDelta[2] = (int16)Delta.Z;
+	Frame.KeyframeSlot = (uint8)((NumKeyframes - 1) & KeyframeMask);
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		Frame.Velocity[Axis] = FFloat16((float)State.Velocity[Axis]);
+		Frame.Force[Axis] = FFloat16((float)State.Force[Axis] * ForceScale);
+	}
+	Frame.Rotation[0] = FRotator::CompressAxisToShort(State.Rotation.Pitch);
+	Frame.Rotation[1] = FRotator::CompressAxisToShort(State.Rotation.Yaw);
+	Frame.Rotation[2] = FRotator::CompressAxisToShort(State.Rotation.Roll);
+	Frame.bIsGrounded = State.bIsGrounded ? 1 : 0;
+
+	if (NumFrames == 0 || Step != NewestStep)
+	{
+		NumFrames = FMath::Min(NumFrames + 1, FrameMask + 1);
+	}
+	NewestStep = Step;
+}
+
+uint32 FPawnStateHistory::GetOldestStep() const
+{
+	const uint32 OldestFrame = NewestStep - (NumFrames - 1);
+
+	// Frames before the oldest keyframe still in the ring lost theirs to a newer one
+	if (NumKeyframes <= KeyframeMask + 1) return OldestFrame;
+	return FMath::Max(OldestFrame, KeyframeSteps[NumKeyframes & KeyframeMask]);
+}
+
+bool FPawnStateHistory::Sample(uint32 Step, FPawnHistoryState& OutState) const
+{
+	if (NumFrames == 0 || Step > NewestStep || Step < GetOldestStep()) return false;
+
+	const FPawnHistoryFrame& Frame = Frames[Step & FrameMask];
+	const FVector& Keyframe = Keyframes[Frame.KeyframeSlot];
+
+	OutState.Location = Keyframe + FVector(Frame.LocationDelta[0], Frame.LocationDelta[1], Frame.LocationDelta[2]) * LocationResolution;
+	OutState.Rotation = FRotator(
+		FRotator::DecompressAxisFromShort(Frame.Rotation[0]),
+		FRotator::DecompressAxisFromShort(Frame.Rotation[1]),
+		FRotator::DecompressAxisFromShort(Frame.Rotation[2])
+	);
+	OutState.Velocity = FVector(Frame.Velocity[0], Frame.Velocity[1], Frame.Velocity[2]);
+	OutState.Force = FVector(Frame.Force[0], Frame.Force[1], Frame.Force[2]) / ForceScale;
+	OutState.bIsGrounded = Frame.bIsGrounded != 0;
+	return true;
+}
+
+SIZE_T FPawnStateHistory::GetAllocatedSize() const
+{
+	return Frames.GetAllocatedSize() + Keyframes.GetAllocatedSize() + KeyframeSteps.GetAllocatedSize();
+}
+
+UPawnHistorySubsystem::UPawnHistorySubsystem() :
+	CurrentStep(0),
+	NumSteps(0)
+{
+	StepTimes.SetNumZeroed(HistorySteps);
+}
+
+bool UPawnHistorySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UPawnHistorySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPawnHistorySubsystem, STATGROUP_Tickables);
+}
+
+// Tickable objects run after every actor tick group, so this closes the step the pawns just recorded
+void UPawnHistorySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	StepTimes[CurrentStep & (HistorySteps - 1)] = GetWorld()->GetTimeSeconds();
+	NumSteps = FMath::Min(NumSteps + 1, HistorySteps);
+	++CurrentStep;
+}
+
+void UPawnHistorySubsystem::RecordState(const APawn* Pawn, const FPawnHistoryState& State)
+{
+	if (!Pawn) return;
+
+	FPawnStateHistory* History = Histories.Find(Pawn);
+	if (!History)
+	{
+		History = &Histories.Emplace(Pawn, FPawnStateHistory(HistorySteps, KeyframeInterval));
+	}
+	History->Record(CurrentStep, State);
+}
+
+void UPawnHistorySubsystem::RemovePawn(const APawn* Pawn)
+{
+	Histories.Remove(Pawn);
+}
+
+bool UPawnHistorySubsystem::GetStateAtStep(const APawn* Pawn, uint32 Step, FPawnHistoryState& OutState) const
+{
+	const FPawnStateHistory* History = Histories.Find(Pawn);
+	return History && History->Sample(Step, OutState);
+}
+
+bool UPawnHistorySubsystem::FindStepAtTime(double WorldTime, uint32& OutStep) const
+{
+	if (NumSteps == 0) return false;
+
+	// Step times only grow, binary search the closed steps in the window
+	uint32 Low = CurrentStep - NumSteps;
+	uint32 High = CurrentStep - 1;
+	if (StepTimes[Low & (HistorySteps - 1)] > WorldTime) return false;
+
+	while (Low < High)
+	{
+		const uint32 Mid = Low + (High - Low + 1) / 2;
+		if (StepTimes[Mid & (HistorySteps - 1)] <= WorldTime) Low = Mid;
+		else High = Mid - 1;
+	}
+	OutStep = Low;
+	return true;
+}
+
+float UPawnHistorySubsystem::GetBytesPerPawnPerSecond() const
+{
+	if (NumSteps < 2) return 0.0f;
+
+	const double OldestTime = StepTimes[(CurrentStep - NumSteps) & (HistorySteps - 1)];
+	const double NewestTime = StepTimes[(CurrentStep - 1) & (HistorySteps - 1)];
+	if (NewestTime <= OldestTime) return 0.0f;
+
+	const double StepsPerSecond = (NumSteps - 1) / (NewestTime - OldestTime);
+	const double BytesPerStep = sizeof(FPawnHistoryFrame) + (double)(sizeof(FVector) + sizeof(uint32)) / KeyframeInterval;
+	return (float)(BytesPerStep * StepsPerSecond);
+}
+
+int64 UPawnHistorySubsystem::GetTotalAllocatedBytes() const
+{
+	int64 Total = Histories.GetAllocatedSize();
+	for (const TPair<TObjectKey<APawn>, FPawnStateHistory>& Pair : Histories)
+	{
+		Total += Pair.Value.GetAllocatedSize();
+	}
+	return Total;
+}
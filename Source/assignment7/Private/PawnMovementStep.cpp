@@ -0,0 +1,253 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PawnMovementStep.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "PawnSimGovernorSubsystem.h"
+
+void PawnMovement::SweepNextPosition(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, TArray<FHitResult>& OutHits)
+{
+	FCollisionQueryParams CollisionParams;
+	CollisionParams.AddIgnoredActor(Pawn);
+
+	const FVector NextPosition = Pawn->GetActorLocation() + Velocity * DeltaTime;
+
+	// Zero length sweep, i.e. every overlap at the next position
+	Pawn->GetWorld()->SweepMultiByChannel(
+		OutHits,
+		NextPosition,
+		NextPosition,
+		Rotation,
+		ECollisionChannel::ECC_Visibility,
+		FCollisionShape::MakeCapsule(Capsule->GetScaledCapsuleRadius(), Capsule->GetScaledCapsuleHalfHeight()),
+		CollisionParams
+	);
+}
+
+void FPawnCollisionQuery::Sweep(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, bool bAsync, bool bAllowCached, TArray<FHitResult>& OutHits)
+{
+	UWorld* World = Pawn->GetWorld();
+	const FVector NextPosition = Pawn->GetActorLocation() + Velocity * DeltaTime;
+
+	if (bAllowCached && bHasCache
+		&& GFrameCounter - CachedFrame <= MaxCacheAge
+		&& FVector::DistSquared(NextPosition, CachedPosition) < FMath::Square(CacheReuseDistance)
+		&& CachedRotation.AngularDistance(Rotation) < CacheReuseAngle)
+	{
+		OutHits = CachedHits;
+		return;
+	}
+
+	if (!bAsync)
+	{
+		PendingSweep = FTraceHandle();
+		SweepNow(Pawn, Capsule, Rotation, Velocity, DeltaTime, OutHits);
+		return;
+	}
+
+	// The world only keeps async results for the frame after the request. A handle from before a run of
+	// cache hits or a skipped tick has nothing to give, so this frame sweeps synchronously instead.
+	FTraceDatum Datum;
+	if (PendingSweep.IsValid() && PendingSweepFrame + 1 == GFrameCounter && World->QueryTraceData(PendingSweep, Datum))
+	{
+		CachedHits = MoveTemp(Datum.OutHits);
+		CachedPosition = Datum.Start;
+		CachedRotation = Datum.Rot;
+		CachedFrame = PendingSweepFrame;
+		bHasCache = true;
+		OutHits = CachedHits;
+	}
+	else
+	{
+		SweepNow(Pawn, Capsule, Rotation, Velocity, DeltaTime, OutHits);
+	}
+
+	FCollisionQueryParams CollisionParams;
+	CollisionParams.AddIgnoredActor(Pawn);
+
+	PendingSweep = World->AsyncSweepByChannel(
+		EAsyncTraceType::Multi,
+		NextPosition,
+		NextPosition,
+		Rotation,
+		ECollisionChannel::ECC_Visibility,
+		FCollisionShape::MakeCapsule(Capsule->GetScaledCapsuleRadius(), Capsule->GetScaledCapsuleHalfHeight()),
+		CollisionParams
+	);
+	PendingSweepFrame = GFrameCounter;
+}
+
+void FPawnCollisionQuery::SweepNow(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, TArray<FHitResult>& OutHits)
+{
+	PawnMovement::SweepNextPosition(Pawn, Capsule, Rotation, Velocity, DeltaTime, OutHits);
+	CachedHits = OutHits;
+	CachedPosition = Pawn->GetActorLocation() + Velocity * DeltaTime;
+	CachedRotation = Rotation;
+	CachedFrame = GFrameCounter;
+	bHasCache = true;
+}
+
+PawnMovement::FSimulationFrame PawnMovement::BeginFrame(const APawn* Pawn, float DeltaTime)
+{
+	const UPawnSimGovernorSubsystem* Governor = Pawn->GetWorld()->GetSubsystem<UPawnSimGovernorSubsystem>();
+	const EPawnSimQuality Quality = Governor ? Governor->GetQuality() : EPawnSimQuality::Full;
+
+	FSimulationFrame Frame;
+	Frame.StartCycles = FPlatformTime::Cycles64();
+	Frame.NumSubsteps = UPawnSimGovernorSubsystem::GetNumSubsteps(Quality, DeltaTime);
+	Frame.SubstepDeltaTime = DeltaTime / Frame.NumSubsteps;
+
+	// Controllers keep adding force every frame while a throttled pawn skips ticks, so the sum it
+	// integrates over its longer DeltaTime has to be averaged back down to one frame's worth.
+	// Measured in time, a pause or a re-enabled tick skips frames without adding any.
+	const float WorldDeltaTime = Pawn->GetWorld()->GetDeltaSeconds();
+	Frame.InputScale = Pawn->GetActorTickInterval() > 0.0f && DeltaTime > WorldDeltaTime ? WorldDeltaTime / DeltaTime : 1.0f;
+
+	// A pawn that skips frames would never find its async result
+	Frame.bAsyncSweeps = Quality >= EPawnSimQuality::AsyncSweeps && Pawn->GetActorTickInterval() == 0.0f;
+	Frame.bCachedSweeps = Quality >= EPawnSimQuality::CachedSweeps;
+	return Frame;
+}
+
+void PawnMovement::EndFrame(APawn* Pawn, const FSimulationFrame& Frame)
+{
+	if (UPawnSimGovernorSubsystem* Governor = Pawn->GetWorld()->GetSubsystem<UPawnSimGovernorSubsystem>())
+	{
+		Governor->ReportSimTime(FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - Frame.StartCycles));
+
+		const float TickInterval = Governor->GetTickInterval(Pawn);
+		if (TickInterval > 0.0f && Pawn->GetActorTickInterval() == 0.0f)
+		{
+			// Pawns throttled on the same frame would all tick together every Nth frame and keep the spike,
+			// a random first cooldown spreads them over the interval
+			Pawn->SetActorTickInterval(FMath::FRandRange(0.0f, TickInterval));
+		}
+		else
+		{
+			Pawn->SetActorTickInterval(TickInterval);
+		}
+	}
+}
+
+namespace PawnMovementBenchmark
+{
+	/** The step as it was before the policies: one virtual call per pawn and runtime flag checks. */
+	struct FBranchingStep
+	{
+		virtual ~FBranchingStep() {}
+		virtual void Integrate(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime) const = 0;
+	};
+
+	struct FBranchingDroneStep : public FBranchingStep
+	{
+		virtual void Integrate(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime) const override
+		{
+			State.Force += FVector(0.0f, 0.0f, -Params.Mass * Params.Gravity);
+			State.Force += State.Rotation.Quaternion().GetUpVector() * Params.Mass * Params.Gravity;
+
+			const FRotator Current = State.Rotation;
+			State.Rotation.Roll *= FMath::Pow(1 - Params.BalanceDrag, DeltaTime);
+			State.Rotation.Pitch *= FMath::Pow(1 - Params.BalanceDrag, DeltaTime);
+			State.Rotation.Yaw = FMath::RInterpTo(Current, State.LookRotation, DeltaTime, Params.LookInterpSpeed).Yaw;
+
+			State.Velocity += State.Force * (1 / Params.Mass) * DeltaTime;
+			State.Velocity *= FMath::Pow(1 - Params.AirDrag, DeltaTime);
+			if (State.Velocity.SizeSquared() < 0.1f) State.Velocity = FVector::ZeroVector;
+			State.Force = FVector::ZeroVector;
+		}
+	};
+
+	struct FBranchingWalkingStep : public FBranchingStep
+	{
+		bool bUseGravity = true;
+
+		virtual void Integrate(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime) const override
+		{
+			if (bUseGravity && !State.bIsGrounded)
+			{
+				State.Force += FVector(0.0f, 0.0f, -Params.Mass * Params.Gravity);
+			}
+
+			State.Velocity += State.Force * (1 / Params.Mass) * DeltaTime;
+			State.Velocity *= FMath::Pow(1 - Params.AirDrag, DeltaTime);
+			if (State.bIsGrounded)
+			{
+				State.Velocity *= FMath::Pow(1 - Params.GroundDrag, DeltaTime);
+			}
+			if (State.Velocity.SizeSquared() < 0.1f) State.Velocity = FVector::ZeroVector;
+			State.Force = FVector::ZeroVector;
+		}
+	};
+
+	static void Run(const TArray<FString>& Args)
+	{
+		const int32 NumPawns = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000;
+		const int32 NumSteps = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 100;
+		constexpr float DeltaTime = 1.0f / 60.0f;
+
+		const FBranchingDroneStep DroneStep;
+		const FBranchingWalkingStep WalkingStep;
+
+		// Drones and walkers interleaved the way actors tick, plus the same pawns grouped by policy
+		FRandomStream Random(1234);
+		TArray<FPawnMovementState> Mixed;
+		TArray<FPawnMovementParams> MixedParams;
+		TArray<const FBranchingStep*> MixedSteps;
+		TArray<FPawnMovementState> Drones, Walkers;
+		TArray<FPawnMovementParams> DroneParams, WalkerParams;
+
+		for (int32 Index = 0; Index < NumPawns; ++Index)
+		{
+			const bool bIsDrone = (Index & 1) != 0;
+
+			FPawnMovementState State;
+			State.Velocity = Random.GetUnitVector() * 500.0f;
+			State.Force = Random.GetUnitVector() * 10000.0f;
+			State.Rotation = FRotator(Random.FRandRange(-20.0f, 20.0f), Random.FRandRange(-180.0f, 180.0f), Random.FRandRange(-20.0f, 20.0f));
+			State.LookRotation = FRotator(0.0f, Random.FRandRange(-180.0f, 180.0f), 0.0f);
+			State.bIsGrounded = !bIsDrone && Random.FRand() < 0.5f;
+
+			FPawnMovementParams Params;
+			Params.Mass = 5.0f;
+			Params.AirDrag = bIsDrone ? 0.3f : 0.1f;
+			Params.GroundDrag = 0.7f;
+			Params.BalanceDrag = 0.8f;
+
+			Mixed.Add(State);
+			MixedParams.Add(Params);
+			MixedSteps.Add(bIsDrone ? static_cast<const FBranchingStep*>(&DroneStep) : &WalkingStep);
+			(bIsDrone ? Drones : Walkers).Add(State);
+			(bIsDrone ? DroneParams : WalkerParams).Add(Params);
+		}
+
+		const double BranchingStart = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			for (int32 Index = 0; Index < Mixed.Num(); ++Index)
+			{
+				MixedSteps[Index]->Integrate(Mixed[Index], MixedParams[Index], DeltaTime);
+			}
+		}
+		const double BranchingTime = FPlatformTime::Seconds() - BranchingStart;
+
+		const double PolicyStart = FPlatformTime::Seconds();
+		for (int32 Step = 0; Step < NumSteps; ++Step)
+		{
+			FDroneMovementStep::IntegrateBatch(Drones, DroneParams, DeltaTime);
+			FWalkingMovementStep::IntegrateBatch(Walkers, WalkerParams, DeltaTime);
+		}
+		const double PolicyTime = FPlatformTime::Seconds() - PolicyStart;
+
+		const double PawnSteps = FMath::Max(1.0, (double)NumPawns * NumSteps);
+		UE_LOG(LogTemp, Display, TEXT("Movement step, %d pawns x %d steps (collision sweeps excluded):"), NumPawns, NumSteps);
+		UE_LOG(LogTemp, Display, TEXT("  virtual + branching: %.2f ms (%.1f ns per pawn step)"), BranchingTime * 1000.0, BranchingTime * 1e9 / PawnSteps);
+		UE_LOG(LogTemp, Display, TEXT("  policy batches:      %.2f ms (%.1f ns per pawn step)"), PolicyTime * 1000.0, PolicyTime * 1e9 / PawnSteps);
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("Pawn.BenchmarkMovementStep"),
+		TEXT("Times the policy based movement step against the virtual, branching one. Args: [NumPawns] [NumSteps]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Run));
+}
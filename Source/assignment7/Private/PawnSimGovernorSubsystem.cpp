@@ -0,0 +1,155 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PawnSimGovernorSubsystem.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Quality Level"), STAT_PawnSimQuality, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Sim Time (ms)"), STAT_PawnSimTime, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Smoothed Sim Time (ms)"), STAT_PawnSimSmoothedTime, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Worst Sim Time (ms)"), STAT_PawnSimWorstTime, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Time At Full (s)"), STAT_PawnSimTimeAtFull, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Time At SingleStep (s)"), STAT_PawnSimTimeAtSingleStep, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Time At AsyncSweeps (s)"), STAT_PawnSimTimeAtAsyncSweeps, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Time At CachedSweeps (s)"), STAT_PawnSimTimeAtCachedSweeps, STATGROUP_PawnSim);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Time At ReducedBackgroundTick (s)"), STAT_PawnSimTimeAtReducedBackgroundTick, STATGROUP_PawnSim);
+
+static TAutoConsoleVariable<float> CVarPawnSimBudgetMs(
+	TEXT("Pawn.SimBudgetMs"),
+	2.0f,
+	TEXT("Time in milliseconds all pawns together may spend simulating per frame."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarPawnSimGovernor(
+	TEXT("Pawn.SimGovernor"),
+	1,
+	TEXT("0 keeps pawn simulation at full quality, 1 lowers quality when over Pawn.SimBudgetMs."),
+	ECVF_Default);
+
+UPawnSimGovernorSubsystem::UPawnSimGovernorSubsystem() :
+	Quality(EPawnSimQuality::Full),
+	FrameSimTime(0.0),
+	SmoothedSimTimeMs(0.0f),
+	OverBudgetTime(0.0f),
+	UnderBudgetTime(0.0f),
+	TimeSinceLevelChange(0.0f),
+	bLastChangeWasUpgrade(false),
+	WorstSimTimeMs(0.0f),
+	WindowWorstSimTimeMs(0.0f),
+	WindowTime(0.0f)
+{
+	FMemory::Memzero(TimeAtLevel);
+	for (float& Delay : UpgradeDelays)
+	{
+		Delay = UpgradeDelay;
+	}
+}
+
+bool UPawnSimGovernorSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+TStatId UPawnSimGovernorSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPawnSimGovernorSubsystem, STATGROUP_Tickables);
+}
+
+// Tickable objects run after every actor tick group, so FrameSimTime holds this frame's pawn ticks
+void UPawnSimGovernorSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const float SimTimeMs = (float)(FrameSimTime * 1000.0);
+	FrameSimTime = 0.0;
+	SmoothedSimTimeMs = FMath::Lerp(SmoothedSimTimeMs, SimTimeMs, SmoothingFactor);
+	TimeAtLevel[(int32)Quality] += DeltaTime;
+	TimeSinceLevelChange += DeltaTime;
+
+	WindowWorstSimTimeMs = FMath::Max(WindowWorstSimTimeMs, SimTimeMs);
+	WindowTime += DeltaTime;
+	if (WindowTime >= WorstFrameWindow)
+	{
+		WorstSimTimeMs = WindowWorstSimTimeMs;
+		WindowWorstSimTimeMs = 0.0f;
+		WindowTime = 0.0f;
+	}
+
+	// An upgrade that held through probation was right, the level it came from goes back to the normal delay
+	if (bLastChangeWasUpgrade && TimeSinceLevelChange >= ProbationTime)
+	{
+		UpgradeDelays[(int32)Quality + 1] = UpgradeDelay;
+		bLastChangeWasUpgrade = false;
+	}
+
+	if (CVarPawnSimGovernor.GetValueOnGameThread() == 0)
+	{
+		SetQuality(EPawnSimQuality::Full);
+	}
+	else
+	{
+		const float BudgetMs = CVarPawnSimBudgetMs.GetValueOnGameThread();
+		OverBudgetTime = SmoothedSimTimeMs > BudgetMs ? OverBudgetTime + DeltaTime : 0.0f;
+		UnderBudgetTime = SmoothedSimTimeMs < BudgetMs * UpgradeHeadroom ? UnderBudgetTime + DeltaTime : 0.0f;
+
+		if (OverBudgetTime >= DowngradeDelay && Quality != EPawnSimQuality::ReducedBackgroundTick)
+		{
+			// Falling straight back means the headroom seen at the cheaper level was not real
+			const int32 LowerLevel = (int32)Quality + 1;
+			if (bLastChangeWasUpgrade)
+			{
+				UpgradeDelays[LowerLevel] = FMath::Min(UpgradeDelays[LowerLevel] * 2.0f, MaxUpgradeDelay);
+			}
+			SetQuality((EPawnSimQuality)LowerLevel);
+		}
+		else if (UnderBudgetTime >= UpgradeDelays[(int32)Quality] && Quality != EPawnSimQuality::Full)
+		{
+			SetQuality((EPawnSimQuality)((int32)Quality - 1));
+		}
+	}
+
+	SET_DWORD_STAT(STAT_PawnSimQuality, (uint32)Quality);
+	SET_FLOAT_STAT(STAT_PawnSimTime, SimTimeMs);
+	SET_FLOAT_STAT(STAT_PawnSimSmoothedTime, SmoothedSimTimeMs);
+	SET_FLOAT_STAT(STAT_PawnSimWorstTime, WorstSimTimeMs);
+	SET_FLOAT_STAT(STAT_PawnSimTimeAtFull, TimeAtLevel[(int32)EPawnSimQuality::Full]);
+	SET_FLOAT_STAT(STAT_PawnSimTimeAtSingleStep, TimeAtLevel[(int32)EPawnSimQuality::SingleStep]);
+	SET_FLOAT_STAT(STAT_PawnSimTimeAtAsyncSweeps, TimeAtLevel[(int32)EPawnSimQuality::AsyncSweeps]);
+	SET_FLOAT_STAT(STAT_PawnSimTimeAtCachedSweeps, TimeAtLevel[(int32)EPawnSimQuality::CachedSweeps]);
+	SET_FLOAT_STAT(STAT_PawnSimTimeAtReducedBackgroundTick, TimeAtLevel[(int32)EPawnSimQuality::ReducedBackgroundTick]);
+}
+
+void UPawnSimGovernorSubsystem::SetQuality(EPawnSimQuality NewQuality)
+{
+	if (NewQuality == Quality) return;
+
+	UE_LOG(LogTemp, Log, TEXT("PawnSim: quality %s -> %s (%.2f ms)"),
+		*UEnum::GetValueAsString(Quality), *UEnum::GetValueAsString(NewQuality), SmoothedSimTimeMs);
+
+	// Both timers restart so the next change needs its own full delay
+	bLastChangeWasUpgrade = NewQuality < Quality;
+	Quality = NewQuality;
+	OverBudgetTime = 0.0f;
+	UnderBudgetTime = 0.0f;
+	TimeSinceLevelChange = 0.0f;
+}
+
+float UPawnSimGovernorSubsystem::GetTimeAtLevel(EPawnSimQuality Level) const
+{
+	return Level < EPawnSimQuality::Num ? TimeAtLevel[(int32)Level] : 0.0f;
+}
+
+int32 UPawnSimGovernorSubsystem::GetNumSubsteps(EPawnSimQuality InQuality, float DeltaTime)
+{
+	if (InQuality >= EPawnSimQuality::SingleStep) return 1;
+	return FMath::Clamp(FMath::CeilToInt32(DeltaTime / MaxSubstepDeltaTime), 1, MaxSubsteps);
+}
+
+// Pawns a player neither controls nor sees can run coarser without anyone noticing
+float UPawnSimGovernorSubsystem::GetTickInterval(const APawn* Pawn) const
+{
+	if (Quality < EPawnSimQuality::ReducedBackgroundTick || !Pawn) return 0.0f;
+	if (Pawn->IsPlayerControlled() || Pawn->WasRecentlyRendered(0.5f)) return 0.0f;
+	return BackgroundTickInterval;
+}
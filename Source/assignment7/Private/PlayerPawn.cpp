@@ -7,6 +7,9 @@
 #include "Camera/CameraComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "PawnMovementStep.h"
+#include "PawnHistorySubsystem.h"
+#include "TelemetrySubsystem.h"
 
 // Sets default values
 APlayerPawn::APlayerPawn()
@@ -42,6 +45,7 @@ APlayerPawn::APlayerPawn()
 	bUseGravity = true;
 	Force = FVector(0.0f, 0.0f, 0.0f);
 	Velocity = FVector(0.0f, 0.0f, 0.0f);
+	LastMoveInput = FVector(0.0f, 0.0f, 0.0f);
 
 	CurrentAngleX = 0.0f;
 }
@@ -53,16 +57,45 @@ void APlayerPawn::BeginPlay()
 	
 }
 
+void APlayerPawn::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPawnHistorySubsystem* History = GetWorld()->GetSubsystem<UPawnHistorySubsystem>())
+	{
+		History->RemovePawn(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void APlayerPawn::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 	
 	SetActorRotation(FRotator(0.0f, CurrentAngleX, 0.0f));
-	AddGravity();
-	Integration(DeltaTime);
-	HandleCollision(DeltaTime);
-	UpdatePosition(DeltaTime);
+
+	FPawnMovementState State;
+	State.Force = Force;
+	State.Velocity = Velocity;
+	State.Rotation = GetActorRotation();
+	State.bIsGrounded = bIsGrounded;
+
+	auto ApplySubstep = [this](const FPawnMovementState& StepState, float StepDeltaTime)
+	{
+		Velocity = StepState.Velocity;
+		bIsGrounded = StepState.bIsGrounded;
+		UpdatePosition(StepDeltaTime);
+	};
+
+	// bUseGravity picks the kernel once per tick instead of being checked inside the step
+	const FPawnMovementParams Params = GetMovementParams();
+	const FVector AppliedForce = bUseGravity
+		? FWalkingMovementStep::Simulate(this, CapsuleComp, CollisionQuery, State, Params, DeltaTime, ApplySubstep)
+		: FWeightlessWalkingMovementStep::Simulate(this, CapsuleComp, CollisionQuery, State, Params, DeltaTime, ApplySubstep);
+
+	Force = State.Force;
+	RecordHistory(AppliedForce);
+	RecordTelemetry();
 }
 
 // Called to bind functionality to input
@@ -128,6 +161,8 @@ void APlayerPawn::Move(const FInputActionValue& value)
 	if (!Controller) return;
 
 	const FVector2D MoveInput = value.Get<FVector2D>();
+	LastMoveInput.X = MoveInput.X;
+	LastMoveInput.Y = MoveInput.Y;
 
 	if (!FMath::IsNearlyZero(MoveInput.X) || !FMath::IsNearlyZero(MoveInput.Y))
 	{
@@ -152,6 +187,7 @@ void APlayerPawn::Jump(const FInputActionValue& value)
 {
 	if (!Controller) return;
 	if (!bIsGrounded) return;
+	LastMoveInput.Z = 1.0f;
 	AddForce(FVector(0.0f, 0.0f, JumpScalar));
 }
 
@@ -182,28 +218,14 @@ void APlayerPawn::AddForce(FVector ExternalForce)
 	Force += ExternalForce;
 }
 
-void APlayerPawn::AddGravity()
+FPawnMovementParams APlayerPawn::GetMovementParams() const
 {
-	if (!bUseGravity || bIsGrounded)
-		return;
-	FVector GravityForce = FVector(0.0f, 0.0f, -Mass * Gravity); // * ߷
-	AddForce(GravityForce);
-}
-
-void APlayerPawn::Integration(float DeltaTime)
-{
-	FVector Acceleration = Force * (1 / Mass); //F = ma
-	Velocity += Acceleration * DeltaTime;
-
-	Velocity *= FMath::Pow(1 - AirDrag, DeltaTime); // ⸶
-	if (bIsGrounded)
-		Velocity *= FMath::Pow(1 - Drag, DeltaTime); // 鸶
-
-	if (Velocity.SizeSquared() < 0.1f)
-	{
-		Velocity = FVector::ZeroVector;
-	}
-	Force = FVector::ZeroVector; //  ʱȭ
+	FPawnMovementParams Params;
+	Params.Mass = Mass;
+	Params.Gravity = Gravity;
+	Params.AirDrag = AirDrag;
+	Params.GroundDrag = Drag;
+	return Params;
 }
 
 void APlayerPawn::UpdatePosition(float DeltaTime)
@@ -212,46 +234,25 @@ void APlayerPawn::UpdatePosition(float DeltaTime)
 	AddActorWorldOffset(Velocity * DeltaTime); // ġ ̵
 }
 
-void APlayerPawn::HandleCollision(float DeltaTime)
+void APlayerPawn::RecordHistory(const FVector& AppliedForce)
 {
-	TArray<FHitResult> HitResults;
-	FCollisionQueryParams CollisionParams;	//Ž    ü
-	CollisionParams.AddIgnoredActor(this);	//÷̾  
-
-	float Radius = CapsuleComp->GetScaledCapsuleRadius();
-	float HalfHeight = CapsuleComp->GetScaledCapsuleHalfHeight();
-
-
-	FVector NextPosition = GetActorLocation() + Velocity * DeltaTime;// ̵ ġ
-
-	bool bIsGround = false;
-
-	bool bHit = GetWorld()->SweepMultiByChannel(
-		HitResults,											//ù°  浹  ü
-		NextPosition,										// ġ
-		NextPosition,										// ġ
-		GetActorQuat(),										//ȸ
-		ECollisionChannel::ECC_Visibility,					//  浹 
-		FCollisionShape::MakeCapsule(Radius, HalfHeight),	//浹
-		CollisionParams										//  ߰ Ű
-	);
-	
-	for (const FHitResult& HitResult : HitResults) {
-		FVector ImpactNormal = HitResult.ImpactNormal;					//浹 ǥ   (ǥ ٱ Ű )
-		float DotProduct = FVector::DotProduct(Velocity, ImpactNormal);	// (  ̰)
-
-		if (DotProduct < 0)
-		{
-			Velocity -= DotProduct * ImpactNormal;
-		}
-
-		if (FMath::IsNearlyEqual(FVector::DotProduct(FVector(0, 0, 1), HitResult.ImpactNormal)/*ٴ Ȯ*/, 1.0f/*ġѴٸ*/, 0.0f/**/))
-		{
-			bIsGround = true;
-			if (Velocity.Z < 0) Velocity.Z = 0;
-		}
+	if (UPawnHistorySubsystem* History = GetWorld()->GetSubsystem<UPawnHistorySubsystem>())
+	{
+		FPawnHistoryState State;
+		State.Location = GetActorLocation();
+		State.Rotation = GetActorRotation();
+		State.Velocity = Velocity;
+		State.Force = AppliedForce;
+		State.bIsGrounded = bIsGrounded;
+		History->RecordState(this, State);
 	}
+}
 
-	if (bIsGround) bIsGrounded = true;
-	else bIsGrounded = false;
+void APlayerPawn::RecordTelemetry()
+{
+	if (UTelemetrySubsystem* Telemetry = GetWorld()->GetSubsystem<UTelemetrySubsystem>())
+	{
+		Telemetry->Record(this, Velocity, LastMoveInput, bIsGrounded);
+	}
+	LastMoveInput = FVector::ZeroVector; // input actions only fire on the frames they are held
 }
\ No newline at end of file
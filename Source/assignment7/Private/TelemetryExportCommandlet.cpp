@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TelemetryExportCommandlet.h"
+#include "TelemetrySubsystem.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/Paths.h"
+
+UTelemetryExportCommandlet::UTelemetryExportCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UTelemetryExportCommandlet::Main(const FString& Params)
+{
+	FString InFilename;
+	if (!FParse::Value(*Params, TEXT("In="), InFilename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=TelemetryExport -In=<file.ptlm> [-Out=<file.csv>]"));
+		return 1;
+	}
+	FString OutFilename;
+	if (!FParse::Value(*Params, TEXT("Out="), OutFilename))
+	{
+		OutFilename = FPaths::ChangeExtension(InFilename, TEXT("csv"));
+	}
+
+	TUniquePtr<IFileHandle> InFile(FPlatformFileManager::Get().GetPlatformFile().OpenRead(*InFilename));
+	if (!InFile)
+	{
+		UE_LOG(LogTemp, Error, TEXT("TelemetryExport: could not open %s"), *InFilename);
+		return 1;
+	}
+
+	FTelemetryFileHeader Header;
+	if (!InFile->Read(reinterpret_cast<uint8*>(&Header), sizeof(Header)) ||
+		Header.Magic != FTelemetryFileHeader::ExpectedMagic ||
+		Header.Version != FTelemetryFileHeader::CurrentVersion ||
+		Header.RecordSize != sizeof(FTelemetryRecord))
+	{
+		UE_LOG(LogTemp, Error, TEXT("TelemetryExport: %s is not a telemetry file of this version"), *InFilename);
+		return 1;
+	}
+
+	TUniquePtr<FArchive> OutFile(IFileManager::Get().CreateFileWriter(*OutFilename));
+	if (!OutFile)
+	{
+		UE_LOG(LogTemp, Error, TEXT("TelemetryExport: could not create %s"), *OutFilename);
+		return 1;
+	}
+
+	auto WriteLine = [&OutFile](const FString& Line)
+	{
+		const FTCHARToUTF8 Utf8(*Line);
+		OutFile->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+	};
+
+	WriteLine(TEXT("PawnId,Step,PositionX,PositionY,PositionZ,VelocityX,VelocityY,VelocityZ,InputX,InputY,InputZ,bIsGrounded\n"));
+
+	// A crash may leave a partial record at the end, only whole records are exported
+	const int64 NumRecords = (InFile->Size() - (int64)sizeof(Header)) / sizeof(FTelemetryRecord);
+
+	TArray<FTelemetryRecord> Records;
+	Records.SetNumUninitialized(FTelemetryChunk::Capacity);
+
+	FString Lines;
+	for (int64 First = 0; First < NumRecords; First += FTelemetryChunk::Capacity)
+	{
+		const int32 Num = (int32)FMath::Min<int64>(FTelemetryChunk::Capacity, NumRecords - First);
+		if (!InFile->Read(reinterpret_cast<uint8*>(Records.GetData()), Num * sizeof(FTelemetryRecord))) break;
+
+		Lines.Reset();
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			const FTelemetryRecord& Record = Records[Index];
+			Lines += FString::Printf(TEXT("%u,%u,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d\n"),
+				Record.PawnId, Record.Step,
+				Record.Position.X, Record.Position.Y, Record.Position.Z,
+				Record.Velocity.X, Record.Velocity.Y, Record.Velocity.Z,
+				Record.Input.X, Record.Input.Y, Record.Input.Z,
+				Record.bIsGrounded);
+		}
+		WriteLine(Lines);
+	}
+
+	OutFile->Close();
+	UE_LOG(LogTemp, Display, TEXT("TelemetryExport: wrote %lld records to %s"), NumRecords, *OutFilename);
+	return 0;
+}
@@ -0,0 +1,330 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TelemetrySubsystem.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+DECLARE_CYCLE_STAT(TEXT("Flush"), STAT_TelemetryFlush, STATGROUP_Telemetry);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Records Written"), STAT_TelemetryWritten, STATGROUP_Telemetry);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Records Dropped"), STAT_TelemetryDropped, STATGROUP_Telemetry);
+
+static TAutoConsoleVariable<int32> CVarTelemetryRecord(
+	TEXT("Telemetry.Record"),
+	0,
+	TEXT("Record pawn trajectories to Saved/Telemetry. Takes effect for worlds created afterwards."),
+	ECVF_Default);
+
+FTelemetryRecorder::FTelemetryRecorder() :
+	Thread(nullptr),
+	WakeEvent(FPlatformProcess::GetSynchEventFromPool(false)),
+	TlsSlot(FPlatformTLS::AllocTlsSlot()),
+	NumChunks(0),
+	bStopping(false),
+	NumWritten(0),
+	NumDropped(0)
+{
+}
+
+FTelemetryRecorder::~FTelemetryRecorder()
+{
+	Shutdown();
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	FPlatformTLS::FreeTlsSlot(TlsSlot);
+}
+
+bool FTelemetryRecorder::Start(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	FileHandle.Reset(PlatformFile.OpenWrite(*Filename, true));
+	if (!FileHandle) return false;
+
+	if (FileHandle->Size() == 0)
+	{
+		FTelemetryFileHeader Header;
+		Header.Magic = FTelemetryFileHeader::ExpectedMagic;
+		Header.Version = FTelemetryFileHeader::CurrentVersion;
+		Header.RecordSize = sizeof(FTelemetryRecord);
+		Header.Reserved = 0;
+		FileHandle->Write(reinterpret_cast<const uint8*>(&Header), sizeof(Header));
+	}
+
+	Thread = FRunnableThread::Create(this, TEXT("TelemetryWriter"), 0, TPri_BelowNormal);
+	return Thread != nullptr;
+}
+
+void FTelemetryRecorder::Shutdown()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	// Producers are done, so their partial chunks can be collected from here
+	for (const TUniquePtr<FThreadBuffer>& Buffer : ThreadBuffers)
+	{
+		if (Buffer->Current && Buffer->Current->Num > 0)
+		{
+			Submit(Buffer->Current);
+			Buffer->Current = nullptr;
+		}
+	}
+
+	if (FileHandle)
+	{
+		WritePending();
+		FileHandle.Reset();
+	}
+}
+
+FTelemetryRecorder::FThreadBuffer& FTelemetryRecorder::GetThreadBuffer()
+{
+	FThreadBuffer* Buffer = static_cast<FThreadBuffer*>(FPlatformTLS::GetTlsValue(TlsSlot));
+	if (!Buffer)
+	{
+		FScopeLock Lock(&RegistryLock);
+		Buffer = ThreadBuffers.Add_GetRef(MakeUnique<FThreadBuffer>()).Get();
+		FPlatformTLS::SetTlsValue(TlsSlot, Buffer);
+	}
+	return *Buffer;
+}
+
+FTelemetryChunk* FTelemetryRecorder::AcquireChunk()
+{
+	if (FTelemetryChunk* Chunk = FreeChunks.Pop())
+	{
+		return Chunk;
+	}
+
+	// Once the pool is full every record is dropped until the writer catches up, without locking for it
+	if (NumChunks.load(std::memory_order_relaxed) >= MaxChunks) return nullptr;
+
+	FScopeLock Lock(&RegistryLock);
+	if (AllChunks.Num() >= MaxChunks) return nullptr;
+	NumChunks.store(AllChunks.Num() + 1, std::memory_order_relaxed);
+	return AllChunks.Add_GetRef(MakeUnique<FTelemetryChunk>()).Get();
+}
+
+void FTelemetryRecorder::Submit(FTelemetryChunk* Chunk)
+{
+	FullChunks.Enqueue(Chunk);
+	WakeEvent->Trigger();
+}
+
+void FTelemetryRecorder::Record(const FTelemetryRecord& InRecord)
+{
+	if (bStopping.load(std::memory_order_relaxed)) return;
+
+	FThreadBuffer& Buffer = GetThreadBuffer();
+	if (!Buffer.Current)
+	{
+		Buffer.Current = AcquireChunk();
+		if (!Buffer.Current)
+		{
+			// The writer fell behind, losing samples beats stalling the frame
+			NumDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	}
+
+	Buffer.Current->Records[Buffer.Current->Num++] = InRecord;
+	if (Buffer.Current->Num == FTelemetryChunk::Capacity)
+	{
+		Submit(Buffer.Current);
+		Buffer.Current = nullptr;
+	}
+}
+
+void FTelemetryRecorder::FlushThreadBuffer()
+{
+	FThreadBuffer& Buffer = GetThreadBuffer();
+	if (Buffer.Current && Buffer.Current->Num > 0)
+	{
+		Submit(Buffer.Current);
+		Buffer.Current = nullptr;
+	}
+}
+
+uint32 FTelemetryRecorder::Run()
+{
+	while (!bStopping.load())
+	{
+		WakeEvent->Wait(FlushIntervalMs);
+		WritePending();
+	}
+	return 0;
+}
+
+void FTelemetryRecorder::Stop()
+{
+	bStopping.store(true);
+	WakeEvent->Trigger();
+}
+
+void FTelemetryRecorder::WritePending()
+{
+	bool bWroteAny = false;
+
+	FTelemetryChunk* Chunk = nullptr;
+	while (FullChunks.Dequeue(Chunk))
+	{
+		FileHandle->Write(reinterpret_cast<const uint8*>(Chunk->Records), Chunk->Num * sizeof(FTelemetryRecord));
+		NumWritten.fetch_add(Chunk->Num, std::memory_order_relaxed);
+		bWroteAny = true;
+
+		Chunk->Num = 0;
+		FreeChunks.Push(Chunk);
+	}
+
+	if (bWroteAny)
+	{
+		FileHandle->Flush();
+	}
+}
+
+bool UTelemetrySubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return Super::ShouldCreateSubsystem(Outer) && CVarTelemetryRecord.GetValueOnGameThread() != 0;
+}
+
+bool UTelemetrySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UTelemetrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	const FString Filename = FPaths::ProjectSavedDir() / TEXT("Telemetry") /
+		FString::Printf(TEXT("%s_%s.ptlm"), *GetWorld()->GetMapName(), *FDateTime::Now().ToString());
+
+	Recorder = MakeUnique<FTelemetryRecorder>();
+	if (!Recorder->Start(Filename))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Telemetry: could not open %s"), *Filename);
+		Recorder.Reset();
+	}
+}
+
+void UTelemetrySubsystem::Deinitialize()
+{
+	if (Recorder)
+	{
+		Recorder->Shutdown();
+		UE_LOG(LogTemp, Log, TEXT("Telemetry: wrote %llu records, dropped %llu"), Recorder->GetNumWritten(), Recorder->GetNumDropped());
+		Recorder.Reset();
+	}
+
+	Super::Deinitialize();
+}
+
+TStatId UTelemetrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UTelemetrySubsystem, STATGROUP_Tickables);
+}
+
+// Pawn ticks are done by now, push out this frame's game thread samples
+void UTelemetrySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!Recorder) return;
+
+	{
+		SCOPE_CYCLE_COUNTER(STAT_TelemetryFlush);
+		Recorder->FlushThreadBuffer();
+	}
+	SET_DWORD_STAT(STAT_TelemetryWritten, Recorder->GetNumWritten());
+	SET_DWORD_STAT(STAT_TelemetryDropped, Recorder->GetNumDropped());
+}
+
+void UTelemetrySubsystem::Record(const APawn* Pawn, const FVector& Velocity, const FVector& Input, bool bIsGrounded)
+{
+	if (!Recorder || !Pawn) return;
+
+	uint32* PawnId = PawnIds.Find(Pawn);
+	if (!PawnId)
+	{
+		PawnId = &PawnIds.Add(Pawn, NextPawnId++);
+	}
+
+	FTelemetryRecord Record;
+	Record.PawnId = *PawnId;
+	Record.Step = (uint32)GFrameCounter;
+	Record.Position = FVector3f(Pawn->GetActorLocation());
+	Record.Velocity = FVector3f(Velocity);
+	Record.Input = FVector3f(Input);
+	Record.bIsGrounded = bIsGrounded ? 1 : 0;
+	Record.Padding[0] = Record.Padding[1] = Record.Padding[2] = 0;
+	Recorder->Record(Record);
+}
+
+namespace TelemetryBenchmark
+{
+	// Records NumPawns samples per frame at a fixed frame rate, so the writer runs alongside as it would in game
+	static void Run(const TArray<FString>& Args)
+	{
+		const int32 NumPawns = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		const int32 NumFrames = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 300;
+		constexpr double FrameTime = 1.0 / 60.0;
+
+		const FString Filename = FPaths::ProjectSavedDir() / TEXT("Telemetry") / TEXT("Benchmark.ptlm");
+		IFileManager::Get().Delete(*Filename);
+
+		TUniquePtr<FTelemetryRecorder> Recorder = MakeUnique<FTelemetryRecorder>();
+		if (!Recorder->Start(Filename))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Telemetry: could not open %s"), *Filename);
+			return;
+		}
+
+		FRandomStream Random(1234);
+		FTelemetryRecord Record;
+		FMemory::Memzero(Record);
+
+		double TotalTime = 0.0;
+		double MaxTime = 0.0;
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			const double FrameStart = FPlatformTime::Seconds();
+			for (int32 Pawn = 0; Pawn < NumPawns; ++Pawn)
+			{
+				Record.PawnId = Pawn;
+				Record.Step = Frame;
+				Record.Position = FVector3f(Random.GetUnitVector() * 1000.0f);
+				Recorder->Record(Record);
+			}
+			Recorder->FlushThreadBuffer();
+
+			const double RecordTime = FPlatformTime::Seconds() - FrameStart;
+			TotalTime += RecordTime;
+			MaxTime = FMath::Max(MaxTime, RecordTime);
+			FPlatformProcess::Sleep((float)FMath::Max(0.0, FrameTime - RecordTime));
+		}
+
+		Recorder->Shutdown();
+		const double AverageTime = TotalTime / FMath::Max(1, NumFrames);
+		UE_LOG(LogTemp, Display, TEXT("Telemetry recorder, %d pawns x %d frames at 60 fps:"), NumPawns, NumFrames);
+		UE_LOG(LogTemp, Display, TEXT("  game thread: %.3f ms per frame (%.2f%% of the frame), worst %.3f ms"), AverageTime * 1000.0, AverageTime / FrameTime * 100.0, MaxTime * 1000.0);
+		UE_LOG(LogTemp, Display, TEXT("  written %llu, dropped %llu"), Recorder->GetNumWritten(), Recorder->GetNumDropped());
+
+		Recorder.Reset();
+		IFileManager::Get().Delete(*Filename);
+	}
+
+	static FAutoConsoleCommand Command(
+		TEXT("Telemetry.Benchmark"),
+		TEXT("Times recording and flushing NumPawns samples per 60 fps frame as a share of the frame. Args: [NumPawns] [NumFrames]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&Run));
+}
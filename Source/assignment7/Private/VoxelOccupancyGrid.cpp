@@ -0,0 +1,205 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "VoxelOccupancyGrid.h"
+#include "Algo/Reverse.h"
+
+FVoxelOccupancyGrid::FVoxelOccupancyGrid(const FVector& InOrigin, float InVoxelSize, const FIntVector& InMinVoxel, const FIntVector& InMaxVoxel) :
+	Origin(InOrigin),
+	VoxelSize(InVoxelSize),
+	MinVoxel(InMinVoxel),
+	MaxVoxel(InMaxVoxel)
+{
+}
+
+FIntVector FVoxelOccupancyGrid::GetBrick(const FIntVector& Voxel)
+{
+	return FIntVector(Voxel.X >> 2, Voxel.Y >> 2, Voxel.Z >> 2);
+}
+
+uint64 FVoxelOccupancyGrid::GetBrickBit(const FIntVector& Voxel)
+{
+	return 1ull << ((Voxel.X & 3) | ((Voxel.Y & 3) << 2) | ((Voxel.Z & 3) << 4));
+}
+
+bool FVoxelOccupancyGrid::IsInBounds(const FIntVector& Voxel) const
+{
+	return Voxel.X >= MinVoxel.X && Voxel.Y >= MinVoxel.Y && Voxel.Z >= MinVoxel.Z &&
+		Voxel.X <= MaxVoxel.X && Voxel.Y <= MaxVoxel.Y && Voxel.Z <= MaxVoxel.Z;
+}
+
+bool FVoxelOccupancyGrid::IsOccupied(const FIntVector& Voxel) const
+{
+	const uint64* Mask = Bricks.Find(GetBrick(Voxel));
+	return Mask && (*Mask & GetBrickBit(Voxel)) != 0;
+}
+
+void FVoxelOccupancyGrid::SetOccupied(const FIntVector& Voxel, bool bOccupied)
+{
+	const FIntVector Brick = GetBrick(Voxel);
+	if (bOccupied)
+	{
+		Bricks.FindOrAdd(Brick, 0) |= GetBrickBit(Voxel);
+	}
+	else if (uint64* Mask = Bricks.Find(Brick))
+	{
+		*Mask &= ~GetBrickBit(Voxel);
+		if (*Mask == 0) Bricks.Remove(Brick);
+	}
+}
+
+FIntVector FVoxelOccupancyGrid::WorldToVoxel(const FVector& Location) const
+{
+	const FVector Local = (Location - Origin) / VoxelSize;
+	return FIntVector(FMath::FloorToInt32(Local.X), FMath::FloorToInt32(Local.Y), FMath::FloorToInt32(Local.Z));
+}
+
+FVector FVoxelOccupancyGrid::VoxelToWorld(const FIntVector& Voxel) const
+{
+	return Origin + (FVector(Voxel) + FVector(0.5f)) * VoxelSize;
+}
+
+FBox FVoxelOccupancyGrid::GetWorldBounds() const
+{
+	return FBox(Origin + FVector(MinVoxel) * VoxelSize, Origin + FVector(MaxVoxel + FIntVector(1)) * VoxelSize);
+}
+
+bool FVoxelOccupancyGrid::FindNearestFree(const FIntVector& Voxel, int32 MaxRadius, FIntVector& OutVoxel) const
+{
+	if (!IsBlocked(Voxel))
+	{
+		OutVoxel = Voxel;
+		return true;
+	}
+
+	for (int32 Radius = 1; Radius <= MaxRadius; ++Radius)
+	{
+		int32 BestDistSq = MAX_int32;
+		for (int32 X = -Radius; X <= Radius; ++X)
+		{
+			for (int32 Y = -Radius; Y <= Radius; ++Y)
+			{
+				for (int32 Z = -Radius; Z <= Radius; ++Z)
+				{
+					// Only the shell, inner voxels were checked by the smaller radii
+					if (FMath::Max3(FMath::Abs(X), FMath::Abs(Y), FMath::Abs(Z)) != Radius) continue;
+
+					const FIntVector Candidate = Voxel + FIntVector(X, Y, Z);
+					const int32 DistSq = X * X + Y * Y + Z * Z;
+					if (DistSq < BestDistSq && !IsBlocked(Candidate))
+					{
+						BestDistSq = DistSq;
+						OutVoxel = Candidate;
+					}
+				}
+			}
+		}
+		if (BestDistSq != MAX_int32) return true;
+	}
+	return false;
+}
+
+namespace VoxelSearch
+{
+	struct FNode
+	{
+		float G;
+		FIntVector Parent;
+		bool bClosed;
+	};
+
+	struct FOpenEntry
+	{
+		float F;
+		float G;
+		FIntVector Voxel;
+	};
+
+	struct FOpenEntryPredicate
+	{
+		bool operator()(const FOpenEntry& A, const FOpenEntry& B) const { return A.F < B.F; }
+	};
+
+	// Octile distance generalized to three axes, exact for an empty grid
+	static float Heuristic(const FIntVector& From, const FIntVector& To)
+	{
+		int32 D[3] = { FMath::Abs(To.X - From.X), FMath::Abs(To.Y - From.Y), FMath::Abs(To.Z - From.Z) };
+		if (D[0] < D[1]) Swap(D[0], D[1]);
+		if (D[1] < D[2]) Swap(D[1], D[2]);
+		if (D[0] < D[1]) Swap(D[0], D[1]);
+
+		return D[0] + (UE_SQRT_2 - 1.0f) * D[1] + (UE_SQRT_3 - UE_SQRT_2) * D[2];
+	}
+}
+
+bool FVoxelOccupancyGrid::FindPath(const FIntVector& Start, const FIntVector& Goal, int32 MaxExpansions, TArray<FIntVector>& OutPath) const
+{
+	using namespace VoxelSearch;
+
+	OutPath.Reset();
+	if (IsBlocked(Start) || IsBlocked(Goal)) return false;
+
+	TMap<FIntVector, FNode> Nodes;
+	TArray<FOpenEntry> Open;
+
+	Nodes.Add(Start, FNode{ 0.0f, Start, false });
+	Open.HeapPush(FOpenEntry{ Heuristic(Start, Goal), 0.0f, Start }, FOpenEntryPredicate());
+
+	int32 Expansions = 0;
+	while (Open.Num() > 0)
+	{
+		FOpenEntry Entry;
+		Open.HeapPop(Entry, FOpenEntryPredicate(), EAllowShrinking::No);
+
+		FNode& Current = Nodes.FindChecked(Entry.Voxel);
+		if (Current.bClosed || Entry.G > Current.G) continue; // stale duplicate
+		Current.bClosed = true;
+
+		if (Entry.Voxel == Goal)
+		{
+			for (FIntVector Voxel = Goal; Voxel != Start; Voxel = Nodes.FindChecked(Voxel).Parent)
+			{
+				OutPath.Add(Voxel);
+			}
+			OutPath.Add(Start);
+			Algo::Reverse(OutPath);
+			return true;
+		}
+
+		if (++Expansions > MaxExpansions) return false;
+
+		for (int32 DX = -1; DX <= 1; ++DX)
+		{
+			for (int32 DY = -1; DY <= 1; ++DY)
+			{
+				for (int32 DZ = -1; DZ <= 1; ++DZ)
+				{
+					if (DX == 0 && DY == 0 && DZ == 0) continue;
+
+					const FIntVector Next = Entry.Voxel + FIntVector(DX, DY, DZ);
+					if (IsBlocked(Next)) continue;
+
+					// Diagonal moves must not slip between blocked voxels
+					if ((DX != 0 && IsBlocked(Entry.Voxel + FIntVector(DX, 0, 0))) ||
+						(DY != 0 && IsBlocked(Entry.Voxel + FIntVector(0, DY, 0))) ||
+						(DZ != 0 && IsBlocked(Entry.Voxel + FIntVector(0, 0, DZ))))
+					{
+						continue;
+					}
+
+					const int32 Axes = (DX != 0) + (DY != 0) + (DZ != 0);
+					const float StepCost = Axes == 1 ? 1.0f : (Axes == 2 ? UE_SQRT_2 : UE_SQRT_3);
+					const float G = Entry.G + StepCost;
+
+					FNode* NextNode = Nodes.Find(Next);
+					if (NextNode && (NextNode->bClosed || NextNode->G <= G)) continue;
+					if (!NextNode) NextNode = &Nodes.Add(Next);
+
+					*NextNode = FNode{ G, Entry.Voxel, false };
+					Open.HeapPush(FOpenEntry{ G + Heuristic(Next, Goal), G, Next }, FOpenEntryPredicate());
+				}
+			}
+		}
+	}
+	return false;
+}
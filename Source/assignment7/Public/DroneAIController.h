@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "DroneNavSubsystem.h"
+#include "DroneAIController.generated.h"
+
+class ADronePawn;
+
+/**
+ * Flies an ADronePawn along voxel paths from UDroneNavSubsystem.
+ * Paths are turned into the same pitch/roll/lift inputs ADroneController produces from the player.
+ */
+UCLASS()
+class ASSIGNMENT7_API ADroneAIController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	ADroneAIController();
+
+	virtual void Tick(float DeltaTime) override;
+
+	UFUNCTION(BlueprintCallable, Category = "Navigation")
+	void FlyTo(const FVector& InDestination);
+	UFUNCTION(BlueprintCallable, Category = "Navigation")
+	void StopFlying();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float MaxSpeed;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float AcceptanceRadius;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float VelocityGain;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float MaxTiltAngle;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float TiltRate;
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Navigation")
+	float RetryDelay;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void RequestPath();
+	void CancelPendingRequest();
+	void OnPathReady(const FDronePath& InPath, bool bIsRepair);
+	void OnGridChanged(const TSet<FIntVector>& ChangedVoxels);
+	void FollowPath(ADronePawn* Drone, float DeltaTime);
+
+	FDronePath Path;
+	int32 PathIndex;
+	FVector Destination;
+	bool bHasDestination;
+	uint32 PendingRequestId;
+	float RetryTimer;
+	FDelegateHandle GridChangedHandle;
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "VoxelOccupancyGrid.h"
+#include "DroneNavSubsystem.generated.h"
+
+/** Voxel path from start to goal, with the voxel centers to fly through. */
+struct FDronePath
+{
+	TArray<FIntVector> Voxels;
+	TArray<FVector> Points;
+	uint32 GridVersion = 0;
+	bool bSuccess = false;
+};
+
+DECLARE_DELEGATE_OneParam(FOnDronePathReady, const FDronePath&);
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnDroneNavGridChanged, const TSet<FIntVector>&);
+
+/**
+ * Flying navigation for drones.
+ * Bakes a sparse voxel grid from static collision when play begins and plans paths on background tasks
+ * against an immutable snapshot of it, so the game thread never waits on a search.
+ * Results are delivered from Tick on the game thread.
+ */
+UCLASS()
+class ASSIGNMENT7_API UDroneNavSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UDroneNavSubsystem();
+
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void BakeFromStaticCollision(const FBox& Bounds);
+	// Re-tests a region against collision, e.g. after a door or platform moved
+	void RefreshRegion(const FBox& Region);
+	void SetVoxelsOccupied(TArrayView<const FIntVector> Voxels, bool bOccupied);
+
+	uint32 RequestPath(const FVector& Start, const FVector& Goal, FOnDronePathReady OnReady);
+	// Replans only the blocked stretches of Path after FromIndex and splices them in
+	uint32 RequestRepair(const FDronePath& Path, int32 FromIndex, FOnDronePathReady OnReady);
+	void CancelRequest(uint32 RequestId);
+
+	bool IsPathBlocked(const FDronePath& Path, int32 FromIndex) const;
+	bool IsReady() const { return Grid.IsValid(); }
+
+	FOnDroneNavGridChanged OnGridChanged;
+
+	static constexpr float VoxelSize = 100.0f;
+	// Obstacles are inflated by this much so a path voxel always fits the drone
+	static constexpr float AgentRadius = 60.0f;
+	static constexpr float BakeHeadroom = 2000.0f;
+	static constexpr double MaxBakeExtent = 100000.0;
+	static constexpr int32 MaxExpansions = 50000;
+	static constexpr int32 MaxSnapRadius = 3;
+	static constexpr int32 MaxCachedPaths = 256;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	struct FCompletedRequest
+	{
+		uint32 RequestId;
+		FIntVector StartVoxel;
+		FIntVector GoalVoxel;
+		// INDEX_NONE for a full search
+		int32 RepairFromIndex;
+		FDronePath Path;
+	};
+
+	struct FCachedPath
+	{
+		TArray<FIntVector> Voxels;
+		uint64 LastUsedFrame;
+	};
+
+	using FCompletedQueue = TQueue<FCompletedRequest, EQueueMode::Mpsc>;
+	using FPathKey = TPair<FIntVector, FIntVector>;
+
+	void LaunchSearch(uint32 RequestId, const FIntVector& StartVoxel, const FIntVector& GoalVoxel);
+	void LaunchRepair(uint32 RequestId, const TArray<FIntVector>& Voxels, int32 FromIndex);
+	void BakeNode(FVoxelOccupancyGrid& Target, const FIntVector& MinVoxel, int32 Size) const;
+	void ApplyGridChange(TSharedRef<FVoxelOccupancyGrid> NewGrid, const TSet<FIntVector>& Changed);
+	void AddToCache(const FPathKey& Key, const TArray<FIntVector>& Voxels);
+	void BuildPoints(FDronePath& Path) const;
+
+	TSharedPtr<const FVoxelOccupancyGrid> Grid;
+	TSharedRef<FCompletedQueue> Completed;
+	TMap<uint32, FOnDronePathReady> Pending;
+	TMap<FPathKey, FCachedPath> Cache;
+
+	uint32 NextRequestId;
+	uint32 GridVersion;
+};
@@ -7,6 +7,7 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
+#include "PawnMovementStep.h"
 #include "DroneController.h"
 #include "DronePawn.generated.h"
 
@@ -26,6 +27,7 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
@@ -50,6 +52,13 @@ public:
 	UCameraComponent* CameraComp;
 
 	void AddForce(FVector ExternalForce);
+	// Pitch and roll deltas in X and Y, lift in Z, the same mapping the Move action uses
+	void AddFlightInput(const FVector& FlightInput);
+	void SetLookYaw(float Yaw);
+
+	virtual FVector GetVelocity() const override { return Velocity; }
+	float GetGravity() const { return Gravity; }
+	float GetMoveScalar() const { return MoveScalar; }
 
 protected:
 	UPROPERTY(EditAnywhere, Category = "Physics")
@@ -66,12 +75,12 @@ protected:
 private:
 	FVector Force;
 	FVector Velocity;
+	FVector LastMoveInput;
 	FRotator LookRotation;
+	FPawnCollisionQuery CollisionQuery;
 	 
-	void AddGravity();
-	void AddLift();
-	void Balance(float DeltaTime);
-	void Integration(float DeltaTime);
-	void HandleCollision(float DeltaTime);
+	FPawnMovementParams GetMovementParams() const;
 	void UpdatePosition(float DeltaTime);
+	void RecordHistory(const FVector& AppliedForce);
+	void RecordTelemetry();
 };
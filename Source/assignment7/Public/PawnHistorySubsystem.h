@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Math/Float16.h"
+#include "UObject/ObjectKey.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PawnHistorySubsystem.generated.h"
+
+class APawn;
+
+/**
+ * Full precision pawn state as handed to and returned from the history.
+ * Pawns never scale at runtime, so only location and rotation of the transform are kept.
+ */
+struct FPawnHistoryState
+{
+	FVector Location = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	FVector Velocity = FVector::ZeroVector;
+	FVector Force = FVector::ZeroVector;
+	bool bIsGrounded = false;
+
+	FTransform GetTransform() const { return FTransform(Rotation, Location); }
+};
+
+/**
+ * Quantized state of one step.
+ * Location is stored as a delta against the keyframe in KeyframeSlot, so every frame decodes on its own.
+ */
+struct FPawnHistoryFrame
+{
+	int16 LocationDelta[3];
+	uint16 Rotation[3];
+	FFloat16 Velocity[3];
+	FFloat16 Force[3];
+	uint8 bIsGrounded;
+	uint8 KeyframeSlot;
+};
+
+/**
+ * Fixed-size ring buffer of quantized states for a single pawn.
+ * Steps are indexed directly (Step & Mask), so sampling any step inside the window is O(1).
+ */
+class ASSIGNMENT7_API FPawnStateHistory
+{
+public:
+	// Capacity and KeyframeInterval must be powers of two, Capacity a multiple of KeyframeInterval.
+	// A keyframe starts every KeyframeInterval steps and whenever the pawn moved out of delta range, e.g. a teleport.
+	FPawnStateHistory(uint32 InCapacity, uint32 InKeyframeInterval);
+
+	// Steps skipped since the last record are filled with the previous state
+	void Record(uint32 Step, const FPawnHistoryState& State);
+	bool Sample(uint32 Step, FPawnHistoryState& OutState) const;
+
+	bool IsEmpty() const { return NumFrames == 0; }
+	uint32 GetNewestStep() const { return NewestStep; }
+	uint32 GetOldestStep() const;
+	SIZE_T GetAllocatedSize() const;
+
+	// Centimeters per quantization unit of the location delta
+	static constexpr float LocationResolution = 0.5f;
+	// Force is pre-scaled so that jump impulses stay inside the half float range
+	static constexpr float ForceScale = 1.0f / 64.0f;
+
+private:
+	void WriteFrame(uint32 Step, const FPawnHistoryState& State);
+
+	TArray<FPawnHistoryFrame> Frames;
+	TArray<FVector> Keyframes;
+	// Step each keyframe slot was started at, to tell which frames still have theirs
+	TArray<uint32> KeyframeSteps;
+	FPawnHistoryState LastState;
+
+	uint32 FrameMask;
+	uint32 KeyframeMask;
+	uint32 KeyframeShift;
+	uint32 NewestStep;
+	uint32 NumFrames;
+	uint32 NumKeyframes;
+	uint32 LastKeyframeBlock;
+};
+
+/**
+ * Keeps the last few seconds of Velocity, Force, transform and grounded state for every pawn,
+ * for lag compensation and kill-cam replays.
+ */
+UCLASS()
+class ASSIGNMENT7_API UPawnHistorySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UPawnHistorySubsystem();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	void RecordState(const APawn* Pawn, const FPawnHistoryState& State);
+	void RemovePawn(const APawn* Pawn);
+	bool GetStateAtStep(const APawn* Pawn, uint32 Step, FPawnHistoryState& OutState) const;
+
+	// Latest recorded step whose world time is not after WorldTime
+	bool FindStepAtTime(double WorldTime, uint32& OutStep) const;
+	uint32 GetCurrentStep() const { return CurrentStep; }
+
+	UFUNCTION(BlueprintCallable, Category = "History")
+	float GetBytesPerPawnPerSecond() const;
+	UFUNCTION(BlueprintCallable, Category = "History")
+	int64 GetTotalAllocatedBytes() const;
+
+	// 512 steps is about 8.5 seconds at 60 fps
+	static constexpr uint32 HistorySteps = 512;
+	static constexpr uint32 KeyframeInterval = 16;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	TMap<TObjectKey<APawn>, FPawnStateHistory> Histories;
+	TArray<double> StepTimes;
+	uint32 CurrentStep;
+	uint32 NumSteps;
+};
@@ -0,0 +1,280 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/HitResult.h"
+#include "WorldCollision.h"
+#include "GameFramework/Pawn.h"
+
+class UCapsuleComponent;
+
+/** Tuning values of a pawn, read by the movement step. */
+struct FPawnMovementParams
+{
+	float Mass = 1.0f;
+	float Gravity = 980.0f;
+	float AirDrag = 0.0f;
+	float GroundDrag = 0.0f;
+	float BalanceDrag = 0.0f;
+	float LookInterpSpeed = 5.0f;
+};
+
+/** Simulation state one movement step reads and writes. */
+struct FPawnMovementState
+{
+	FVector Force = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+	FRotator Rotation = FRotator::ZeroRotator;
+	FRotator LookRotation = FRotator::ZeroRotator;
+	bool bIsGrounded = false;
+};
+
+namespace PawnMovement
+{
+	// Overlap sweep of the capsule at the position the pawn moves to this step
+	ASSIGNMENT7_API void SweepNextPosition(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, TArray<FHitResult>& OutHits);
+
+	// Removes the velocity going into each hit surface and stops falling on floors, returns whether a floor was hit
+	FORCEINLINE bool SlideAlongHits(FVector& Velocity, TConstArrayView<FHitResult> Hits, float FloorTolerance)
+	{
+		bool bHitFloor = false;
+		for (const FHitResult& HitResult : Hits)
+		{
+			const float DotProduct = FVector::DotProduct(Velocity, HitResult.ImpactNormal);
+			if (DotProduct < 0)
+			{
+				Velocity -= DotProduct * HitResult.ImpactNormal;
+			}
+
+			if (FMath::IsNearlyEqual(HitResult.ImpactNormal.Z, 1.0f, FloorTolerance))
+			{
+				bHitFloor = true;
+				if (Velocity.Z < 0) Velocity.Z = 0;
+			}
+		}
+		return bHitFloor;
+	}
+}
+
+/**
+ * The collision sweep of one pawn, at the cost the simulation governor allows.
+ * Sync sweeps are exact. Async sweeps hand back last frame's result, taken at about where the pawn is now;
+ * with no result from exactly last frame they fall back to a sync sweep.
+ * Cached sweeps reuse the last hits for at most MaxCacheAge frames, while the next position stays within
+ * CacheReuseDistance and the rotation within CacheReuseAngle of where they were taken.
+ */
+struct ASSIGNMENT7_API FPawnCollisionQuery
+{
+	void Sweep(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, bool bAsync, bool bAllowCached, TArray<FHitResult>& OutHits);
+
+	static constexpr float CacheReuseDistance = 2.0f;
+	// Radians, about one degree
+	static constexpr float CacheReuseAngle = 0.0175f;
+	// A pawn at rest still sees its floor go away within this many frames
+	static constexpr uint64 MaxCacheAge = 8;
+
+private:
+	void SweepNow(const AActor* Pawn, const UCapsuleComponent* Capsule, const FQuat& Rotation, const FVector& Velocity, float DeltaTime, TArray<FHitResult>& OutHits);
+
+	FTraceHandle PendingSweep;
+	uint64 PendingSweepFrame = 0;
+	TArray<FHitResult> CachedHits;
+	FVector CachedPosition = FVector::ZeroVector;
+	FQuat CachedRotation = FQuat::Identity;
+	uint64 CachedFrame = 0;
+	bool bHasCache = false;
+};
+
+namespace PawnMovement
+{
+	/** How one tick gets simulated, as the governor currently allows. */
+	struct FSimulationFrame
+	{
+		uint64 StartCycles;
+		int32 NumSubsteps;
+		float SubstepDeltaTime;
+		// Share of the tick's DeltaTime that is this frame, input force was added once per frame
+		float InputScale;
+		bool bAsyncSweeps;
+		bool bCachedSweeps;
+	};
+
+	ASSIGNMENT7_API FSimulationFrame BeginFrame(const APawn* Pawn, float DeltaTime);
+	// Reports the time since BeginFrame to the governor and applies its tick interval to the pawn
+	ASSIGNMENT7_API void EndFrame(APawn* Pawn, const FSimulationFrame& Frame);
+}
+
+/*
+ * Movement policies. Each one is a stateless struct with a static FORCEINLINE Apply/Resolve,
+ * so a step instantiated from them compiles down to straight-line code with no flag checks.
+ */
+
+struct FNoGravity
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params) {}
+};
+
+struct FConstantGravity
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params)
+	{
+		State.Force.Z -= Params.Mass * Params.Gravity;
+	}
+};
+
+// Gravity switched off by multiplying with the grounded flag instead of branching on it
+struct FAirborneGravity
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params)
+	{
+		State.Force.Z -= Params.Mass * Params.Gravity * (float)!State.bIsGrounded;
+	}
+};
+
+struct FNoLift
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params) {}
+};
+
+// Rotors push along the up vector with exactly the weight, so tilting turns lift into thrust
+struct FRotorLift
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params)
+	{
+		State.Force += State.Rotation.Quaternion().GetUpVector() * Params.Mass * Params.Gravity;
+	}
+};
+
+struct FNoBalance
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime) {}
+};
+
+// Pitch and roll decay back to level while yaw follows the look rotation
+struct FSelfLevelingBalance
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime)
+	{
+		const float Decay = FMath::Pow(1 - Params.BalanceDrag, DeltaTime);
+		const double Yaw = FMath::RInterpTo(State.Rotation, State.LookRotation, DeltaTime, Params.LookInterpSpeed).Yaw;
+
+		State.Rotation.Roll *= Decay;
+		State.Rotation.Pitch *= Decay;
+		State.Rotation.Yaw = Yaw;
+	}
+};
+
+struct FAirFriction
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime)
+	{
+		State.Velocity *= FMath::Pow(1 - Params.AirDrag, DeltaTime);
+	}
+};
+
+// Ground drag scaled by the grounded flag, Pow(1, t) leaves the velocity alone in the air
+struct FGroundFriction
+{
+	static FORCEINLINE void Apply(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime)
+	{
+		State.Velocity *= FMath::Pow(1 - Params.AirDrag, DeltaTime);
+		State.Velocity *= FMath::Pow(1 - Params.GroundDrag * (float)State.bIsGrounded, DeltaTime);
+	}
+};
+
+// Slides along surfaces, floors only stop the fall
+struct FSlideCollision
+{
+	static FORCEINLINE void Resolve(FPawnMovementState& State, TConstArrayView<FHitResult> Hits)
+	{
+		PawnMovement::SlideAlongHits(State.Velocity, Hits, 0.1f);
+	}
+};
+
+// Slides along surfaces and stands on exactly level floors
+struct FGroundingSlideCollision
+{
+	static FORCEINLINE void Resolve(FPawnMovementState& State, TConstArrayView<FHitResult> Hits)
+	{
+		State.bIsGrounded = PawnMovement::SlideAlongHits(State.Velocity, Hits, 0.0f);
+	}
+};
+
+/**
+ * One movement step built from compile-time policies.
+ * Integrate runs before the collision sweep, ResolveHits after it; Simulate runs both around the sweep for a whole tick.
+ * A new pawn type (e.g. a hovercraft) only needs a new combination, or a new policy struct.
+ */
+template<typename GravityPolicy, typename LiftPolicy, typename BalancePolicy, typename FrictionPolicy, typename CollisionPolicy>
+struct TPawnMovementStep
+{
+	// Returns the net force that was applied, the accumulated force is cleared
+	static FORCEINLINE FVector Integrate(FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime)
+	{
+		GravityPolicy::Apply(State, Params);
+		LiftPolicy::Apply(State, Params);
+		BalancePolicy::Apply(State, Params, DeltaTime);
+
+		const FVector AppliedForce = State.Force;
+		State.Velocity += AppliedForce * (1 / Params.Mass) * DeltaTime; // F = ma
+		FrictionPolicy::Apply(State, Params, DeltaTime);
+
+		if (State.Velocity.SizeSquared() < 0.1f)
+		{
+			State.Velocity = FVector::ZeroVector;
+		}
+		State.Force = FVector::ZeroVector;
+		return AppliedForce;
+	}
+
+	static FORCEINLINE void ResolveHits(FPawnMovementState& State, TConstArrayView<FHitResult> Hits)
+	{
+		CollisionPolicy::Resolve(State, Hits);
+	}
+
+	/**
+	 * One tick of a pawn: integrate, sweep and resolve in as many substeps as the governor allows,
+	 * calling ApplySubstep(State, SubstepDeltaTime) after each one so the pawn can apply it to its actor.
+	 * State.Rotation is what the capsule is swept with. Returns the force applied in the last substep.
+	 */
+	template<typename ApplySubstepFunc>
+	static FVector Simulate(APawn* Pawn, const UCapsuleComponent* Capsule, FPawnCollisionQuery& CollisionQuery, FPawnMovementState& State, const FPawnMovementParams& Params, float DeltaTime, ApplySubstepFunc&& ApplySubstep)
+	{
+		const PawnMovement::FSimulationFrame Frame = PawnMovement::BeginFrame(Pawn, DeltaTime);
+
+		// Input force is held for the whole frame, so every substep applies it again
+		const FVector InputForce = State.Force * Frame.InputScale;
+		FVector AppliedForce = FVector::ZeroVector;
+		TArray<FHitResult> HitResults;
+		for (int32 Substep = 0; Substep < Frame.NumSubsteps; ++Substep)
+		{
+			State.Force = InputForce;
+			AppliedForce = Integrate(State, Params, Frame.SubstepDeltaTime);
+
+			CollisionQuery.Sweep(Pawn, Capsule, State.Rotation.Quaternion(), State.Velocity, Frame.SubstepDeltaTime,
+				Frame.bAsyncSweeps, Frame.bCachedSweeps, HitResults);
+			ResolveHits(State, HitResults);
+			ApplySubstep(State, Frame.SubstepDeltaTime);
+		}
+
+		PawnMovement::EndFrame(Pawn, Frame);
+		return AppliedForce;
+	}
+
+	// All pawns of one policy set in a tight loop, no per-pawn dispatch.
+	// Only Pawn.BenchmarkMovementStep uses this: live pawns interleave Integrate with their own sweep and
+	// actor move inside their tick, so they step one at a time through the same inlined policies.
+	static void IntegrateBatch(TArrayView<FPawnMovementState> States, TConstArrayView<FPawnMovementParams> Params, float DeltaTime)
+	{
+		check(States.Num() == Params.Num());
+		for (int32 Index = 0; Index < States.Num(); ++Index)
+		{
+			Integrate(States[Index], Params[Index], DeltaTime);
+		}
+	}
+};
+
+using FDroneMovementStep = TPawnMovementStep<FConstantGravity, FRotorLift, FSelfLevelingBalance, FAirFriction, FSlideCollision>;
+using FWalkingMovementStep = TPawnMovementStep<FAirborneGravity, FNoLift, FNoBalance, FGroundFriction, FGroundingSlideCollision>;
+using FWeightlessWalkingMovementStep = TPawnMovementStep<FNoGravity, FNoLift, FNoBalance, FGroundFriction, FGroundingSlideCollision>;
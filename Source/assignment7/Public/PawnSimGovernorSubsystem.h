@@ -0,0 +1,94 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PawnSimGovernorSubsystem.generated.h"
+
+class APawn;
+
+DECLARE_STATS_GROUP(TEXT("PawnSim"), STATGROUP_PawnSim, STATCAT_Advanced);
+
+/** Pawn simulation quality, each level keeps the reductions of the ones before it. */
+UENUM(BlueprintType)
+enum class EPawnSimQuality : uint8
+{
+	Full,
+	// One movement step per tick however long the frame was
+	SingleStep,
+	// Collision sweeps run async and are resolved a frame late
+	AsyncSweeps,
+	// Pawns that barely moved reuse their previous sweep
+	CachedSweeps,
+	// Pawns nobody controls or sees tick at a lower rate
+	ReducedBackgroundTick,
+	Num UMETA(Hidden)
+};
+
+/**
+ * Watches the time pawns spend simulating each frame against Pawn.SimBudgetMs and steps the quality
+ * down while over budget and back up once there is headroom again.
+ * Levels only change after the budget has been missed, or met with margin, for a while.
+ * The headroom is measured at the cheaper level, so an upgrade that falls back within ProbationTime
+ * doubles the wait before the next attempt from that level.
+ */
+UCLASS()
+class ASSIGNMENT7_API UPawnSimGovernorSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UPawnSimGovernorSubsystem();
+
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Called by pawns at the end of their tick, game thread only
+	void ReportSimTime(double Seconds) { FrameSimTime += Seconds; }
+
+	EPawnSimQuality GetQuality() const { return Quality; }
+	float GetTickInterval(const APawn* Pawn) const;
+
+	UFUNCTION(BlueprintCallable, Category = "Simulation")
+	EPawnSimQuality GetQualityLevel() const { return Quality; }
+	UFUNCTION(BlueprintCallable, Category = "Simulation")
+	float GetTimeAtLevel(EPawnSimQuality Level) const;
+	// Slowest frame of the last WorstFrameWindow seconds, the smoothed time hides spikes
+	UFUNCTION(BlueprintCallable, Category = "Simulation")
+	float GetWorstSimTimeMs() const { return WorstSimTimeMs; }
+
+	static int32 GetNumSubsteps(EPawnSimQuality InQuality, float DeltaTime);
+
+	static constexpr float MaxSubstepDeltaTime = 1.0f / 50.0f;
+	static constexpr int32 MaxSubsteps = 4;
+	static constexpr float BackgroundTickInterval = 1.0f / 15.0f;
+	static constexpr float SmoothingFactor = 0.1f;
+	// Hysteresis: how long the budget has to be missed or met with margin before the level changes
+	static constexpr float DowngradeDelay = 0.25f;
+	static constexpr float UpgradeDelay = 2.0f;
+	static constexpr float MaxUpgradeDelay = 64.0f;
+	static constexpr float ProbationTime = 5.0f;
+	static constexpr float UpgradeHeadroom = 0.7f;
+	static constexpr float WorstFrameWindow = 1.0f;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	void SetQuality(EPawnSimQuality NewQuality);
+
+	EPawnSimQuality Quality;
+	double FrameSimTime;
+	float SmoothedSimTimeMs;
+	float OverBudgetTime;
+	float UnderBudgetTime;
+	float TimeSinceLevelChange;
+	bool bLastChangeWasUpgrade;
+	float WorstSimTimeMs;
+	float WindowWorstSimTimeMs;
+	float WindowTime;
+	float TimeAtLevel[(int32)EPawnSimQuality::Num];
+	// Time under budget needed to upgrade out of each level
+	float UpgradeDelays[(int32)EPawnSimQuality::Num];
+};
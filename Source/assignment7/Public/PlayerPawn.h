@@ -7,6 +7,7 @@
 #include "GameFramework/SpringArmComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
+#include "PawnMovementStep.h"
 #include "PlayerPawnController.h"
 #include "PlayerPawn.generated.h"
 
@@ -26,6 +27,7 @@ public:
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 public:	
 	// Called every frame
@@ -78,11 +80,13 @@ protected:
 private:
 	FVector Force;
 	FVector Velocity;
+	FVector LastMoveInput;
 
 	float CurrentAngleX;
+	FPawnCollisionQuery CollisionQuery;
 
-	void AddGravity();
-	void Integration(float DeltaTime);
-	void HandleCollision(float DeltaTime);
+	FPawnMovementParams GetMovementParams() const;
 	void UpdatePosition(float DeltaTime);
+	void RecordHistory(const FVector& AppliedForce);
+	void RecordTelemetry();
 };
@@ -0,0 +1,22 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "TelemetryExportCommandlet.generated.h"
+
+/**
+ * Converts a telemetry file into a CSV table with one typed column per record field.
+ * Usage: -run=TelemetryExport -In=<file.ptlm> [-Out=<file.csv>]
+ */
+UCLASS()
+class ASSIGNMENT7_API UTelemetryExportCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UTelemetryExportCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,141 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include <atomic>
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "Containers/LockFreeList.h"
+#include "UObject/ObjectKey.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TelemetrySubsystem.generated.h"
+
+class APawn;
+class IFileHandle;
+
+DECLARE_STATS_GROUP(TEXT("Telemetry"), STATGROUP_Telemetry, STATCAT_Advanced);
+
+/** One pawn sample, written to disk as is. PawnId is unique per pawn for the whole session. */
+struct FTelemetryRecord
+{
+	uint32 PawnId;
+	uint32 Step;
+	FVector3f Position;
+	FVector3f Velocity;
+	FVector3f Input;
+	uint8 bIsGrounded;
+	uint8 Padding[3];
+};
+static_assert(sizeof(FTelemetryRecord) == 48, "Telemetry records are a fixed on-disk format");
+
+/** Written once at the start of every telemetry file. */
+struct FTelemetryFileHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x4D4C5450; // "PTLM"
+	static constexpr uint32 CurrentVersion = 1;
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 RecordSize;
+	uint32 Reserved;
+};
+
+struct FTelemetryChunk
+{
+	static constexpr int32 Capacity = 1024;
+
+	FTelemetryRecord Records[Capacity];
+	int32 Num = 0;
+};
+
+/**
+ * Appends fixed-size records to a binary file.
+ * Every producer thread fills its own chunk without locking; full chunks go through a lock-free queue
+ * to a background thread that writes them and hands them back through a lock-free free list.
+ */
+class ASSIGNMENT7_API FTelemetryRecorder : public FRunnable
+{
+public:
+	FTelemetryRecorder();
+	virtual ~FTelemetryRecorder();
+
+	bool Start(const FString& Filename);
+	// Must only be called once producers have stopped recording
+	void Shutdown();
+
+	void Record(const FTelemetryRecord& InRecord);
+	// Hands the calling thread's partially filled chunk to the writer
+	void FlushThreadBuffer();
+
+	uint64 GetNumWritten() const { return NumWritten.load(std::memory_order_relaxed); }
+	uint64 GetNumDropped() const { return NumDropped.load(std::memory_order_relaxed); }
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	// Chunks in flight before records get dropped, 3 MB in total
+	static constexpr int32 MaxChunks = 64;
+	static constexpr uint32 FlushIntervalMs = 100;
+
+private:
+	struct FThreadBuffer
+	{
+		FTelemetryChunk* Current = nullptr;
+	};
+
+	FThreadBuffer& GetThreadBuffer();
+	FTelemetryChunk* AcquireChunk();
+	void Submit(FTelemetryChunk* Chunk);
+	void WritePending();
+
+	TUniquePtr<IFileHandle> FileHandle;
+	FRunnableThread* Thread;
+	FEvent* WakeEvent;
+	uint32 TlsSlot;
+
+	TQueue<FTelemetryChunk*, EQueueMode::Mpsc> FullChunks;
+	TLockFreePointerListUnordered<FTelemetryChunk, PLATFORM_CACHE_LINE_SIZE> FreeChunks;
+
+	// Only touched when a thread records for the first time or the pool grows
+	FCriticalSection RegistryLock;
+	TArray<TUniquePtr<FTelemetryChunk>> AllChunks;
+	TArray<TUniquePtr<FThreadBuffer>> ThreadBuffers;
+
+	// Mirrors AllChunks.Num(), so an exhausted pool is seen without taking RegistryLock
+	std::atomic<int32> NumChunks;
+	std::atomic<bool> bStopping;
+	std::atomic<uint64> NumWritten;
+	std::atomic<uint64> NumDropped;
+};
+
+/**
+ * Records pawn trajectories to Saved/Telemetry for offline analysis.
+ * Enabled with Telemetry.Record 1 before the world is created; convert files with -run=TelemetryExport.
+ */
+UCLASS()
+class ASSIGNMENT7_API UTelemetrySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Game thread only
+	void Record(const APawn* Pawn, const FVector& Velocity, const FVector& Input, bool bIsGrounded);
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	TUniquePtr<FTelemetryRecorder> Recorder;
+
+	// UObject indices get reused after garbage collection, so pawns are numbered on their first record instead
+	TMap<TObjectKey<APawn>, uint32> PawnIds;
+	uint32 NextPawnId = 1;
+};
@@ -0,0 +1,47 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Sparse 3D occupancy grid for flying navigation.
+ * Voxels are grouped into 4x4x4 bricks stored as a 64 bit mask; only bricks with something in them are kept.
+ * The grid is immutable once shared with planner tasks, changes are made on a copy.
+ */
+class ASSIGNMENT7_API FVoxelOccupancyGrid
+{
+public:
+	FVoxelOccupancyGrid(const FVector& InOrigin, float InVoxelSize, const FIntVector& InMinVoxel, const FIntVector& InMaxVoxel);
+
+	bool IsOccupied(const FIntVector& Voxel) const;
+	// Outside the bounds counts as blocked so searches stay inside the baked volume
+	bool IsBlocked(const FIntVector& Voxel) const { return !IsInBounds(Voxel) || IsOccupied(Voxel); }
+	bool IsInBounds(const FIntVector& Voxel) const;
+	void SetOccupied(const FIntVector& Voxel, bool bOccupied);
+
+	FIntVector WorldToVoxel(const FVector& Location) const;
+	FVector VoxelToWorld(const FIntVector& Voxel) const;
+	// Closest free voxel within MaxRadius voxels, used to snap start and goal points off geometry
+	bool FindNearestFree(const FIntVector& Voxel, int32 MaxRadius, FIntVector& OutVoxel) const;
+
+	// A* over the 26-neighbourhood, gives up after MaxExpansions nodes
+	bool FindPath(const FIntVector& Start, const FIntVector& Goal, int32 MaxExpansions, TArray<FIntVector>& OutPath) const;
+
+	float GetVoxelSize() const { return VoxelSize; }
+	const FIntVector& GetMinVoxel() const { return MinVoxel; }
+	const FIntVector& GetMaxVoxel() const { return MaxVoxel; }
+	FBox GetWorldBounds() const;
+	int32 GetNumBricks() const { return Bricks.Num(); }
+	SIZE_T GetAllocatedSize() const { return Bricks.GetAllocatedSize(); }
+
+private:
+	static FIntVector GetBrick(const FIntVector& Voxel);
+	static uint64 GetBrickBit(const FIntVector& Voxel);
+
+	TMap<FIntVector, uint64> Bricks;
+	FVector Origin;
+	float VoxelSize;
+	FIntVector MinVoxel;
+	FIntVector MaxVoxel;
+};